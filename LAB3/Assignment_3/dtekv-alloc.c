@@ -0,0 +1,211 @@
+/* dtekv-alloc.c
+
+   Memory allocation without malloc, on the .heap region of the linker
+   script (__heap_size bytes, 64 KB unless the link overrides it).
+
+   An arena hands out memory by bumping a pointer; arena_mark and
+   arena_reset free everything allocated after a mark at once, which
+   suits per-frame or per-command scratch memory. Arenas are not
+   interrupt safe.
+
+   A pool holds count blocks of one size, carved from an arena, on a
+   free list threaded through the free blocks themselves, so pool_alloc
+   and pool_free are a few loads and stores with interrupts masked and
+   may be called from ISRs. heap_init builds one pool per size class
+   from the heap arena; heap_alloc takes the smallest class that fits
+   and moves up a class when that pool is empty. */
+
+#include "dtekv-lib.h"
+
+extern char _heap_begin[], _heap_end[];
+
+static struct arena heap;
+static struct pool heap_pools[HEAP_CLASSES];
+
+/* function: arena_init
+   Description: Manage size bytes at mem as an arena. */
+void arena_init(struct arena *a, void *mem, unsigned size)
+{
+  unsigned start = ((unsigned) mem + ALLOC_ALIGN - 1) & ~(ALLOC_ALIGN - 1);
+
+  a->base = (char *) start;
+  a->next = a->base;
+  a->end = (char *) mem + size;
+  a->high = 0;
+}
+
+/* function: arena_alloc
+   Description: size bytes, ALLOC_ALIGN aligned, or 0 if the arena is
+   full. */
+void *arena_alloc(struct arena *a, unsigned size)
+{
+  char *p = a->next;
+  unsigned used;
+
+  size = (size + ALLOC_ALIGN - 1) & ~(ALLOC_ALIGN - 1);
+  if (size > (unsigned) (a->end - p))
+    return 0;
+  a->next = p + size;
+  used = a->next - a->base;
+  if (used > a->high)
+    a->high = used;
+  return p;
+}
+
+/* function: arena_mark
+   Description: A position to return to with arena_reset. */
+unsigned arena_mark(struct arena *a)
+{
+  return a->next - a->base;
+}
+
+/* function: arena_reset
+   Description: Free everything allocated since mark (0 frees all). */
+void arena_reset(struct arena *a, unsigned mark)
+{
+  a->next = a->base + mark;
+}
+
+/* function: pool_init
+   Description: Carve count blocks of size bytes from a. Returns 0, or
+   -1 if the arena is too small. */
+int pool_init(struct pool *p, struct arena *a, unsigned size, unsigned count)
+{
+  char *block;
+
+  size = (size + ALLOC_ALIGN - 1) & ~(ALLOC_ALIGN - 1);
+  block = arena_alloc(a, size * count);
+  if (block == 0 || count == 0)
+    return -1;
+
+  p->start = block;
+  p->end = block + size * count;
+  p->size = size;
+  p->count = count;
+  p->used = p->high = p->fails = 0;
+  p->requested = p->allocs = 0;
+  p->free = 0;
+  for (unsigned i = count; i-- > 0; ) {
+    void **b = (void **) (block + i * size);
+    *b = p->free;
+    p->free = b;
+  }
+  return 0;
+}
+
+/* Take a block for a request of request bytes, with the accounting. */
+static void *pool_take(struct pool *p, unsigned request)
+{
+  unsigned flags = irq_save();
+  void **b = p->free;
+
+  if (b) {
+    p->free = *b;
+    if (++p->used > p->high)
+      p->high = p->used;
+    p->allocs++;
+    p->requested += request;
+  } else {
+    p->fails++;
+  }
+  irq_restore(flags);
+  return b;
+}
+
+/* function: pool_alloc
+   Description: One block, or 0 if the pool is empty. Interrupt safe. */
+void *pool_alloc(struct pool *p)
+{
+  return pool_take(p, p->size);
+}
+
+/* function: pool_free
+   Description: Give back a block from pool_alloc. Interrupt safe. */
+void pool_free(struct pool *p, void *block)
+{
+  unsigned flags = irq_save();
+  *(void **) block = p->free;
+  p->free = block;
+  p->used--;
+  irq_restore(flags);
+}
+
+/* function: heap_init
+   Description: Set up the heap arena and a pool of blocks_per_class
+   blocks for each size class. What is left stays available through
+   heap_arena(). Returns 0, or -1 if the heap is too small. */
+int heap_init(unsigned blocks_per_class)
+{
+  arena_init(&heap, _heap_begin, _heap_end - _heap_begin);
+  for (int i = 0; i < HEAP_CLASSES; i++)
+    if (pool_init(&heap_pools[i], &heap, HEAP_MIN_BLOCK << i, blocks_per_class))
+      return -1;
+  return 0;
+}
+
+/* function: heap_arena
+   Description: The arena over the rest of the heap region. */
+struct arena *heap_arena(void)
+{
+  return &heap;
+}
+
+/* function: heap_alloc
+   Description: A block of at least size bytes from the smallest size
+   class that has one free, or 0. Interrupt safe. */
+void *heap_alloc(unsigned size)
+{
+  int c = 0;
+
+  while (c < HEAP_CLASSES && (HEAP_MIN_BLOCK << c) < size)
+    c++;
+  for (; c < HEAP_CLASSES; c++) {
+    void *b = pool_take(&heap_pools[c], size);
+    if (b)
+      return b;
+  }
+  return 0;
+}
+
+/* function: heap_free
+   Description: Give back a block from heap_alloc; 0 is ignored. */
+void heap_free(void *block)
+{
+  for (int c = 0; c < HEAP_CLASSES; c++) {
+    struct pool *p = &heap_pools[c];
+    if ((char *) block >= p->start && (char *) block < p->end) {
+      pool_free(p, block);
+      return;
+    }
+  }
+}
+
+static void dump_field(const char *name, unsigned value)
+{
+  print(name);
+  print_dec(value);
+}
+
+/* function: heap_dump
+   Description: Print arena use and, per size class, blocks in use,
+   the high-water mark, refused allocations and the share of block
+   bytes lost to rounding up requests (internal fragmentation). */
+void heap_dump(void)
+{
+  dump_field("heap: ", heap.end - heap.base);
+  dump_field(" bytes, arena used ", heap.next - heap.base);
+  dump_field(", high ", heap.high);
+  printc('\n');
+  for (int c = 0; c < HEAP_CLASSES; c++) {
+    struct pool *p = &heap_pools[c];
+    unsigned bytes = p->allocs * p->size;
+
+    dump_field("  class ", p->size);
+    dump_field(": used ", p->used);
+    dump_field("/", p->count);
+    dump_field(", high ", p->high);
+    dump_field(", fails ", p->fails);
+    dump_field(", waste ", bytes ? (bytes - p->requested) / (bytes / 100 + 1) : 0);
+    print("%\n");
+  }
+}
@@ -0,0 +1,77 @@
+/* dtekv-clock.c
+
+   Time of day as a binary count of seconds since midnight.
+
+   Adding or subtracting any number of seconds is one modulo, with the
+   hour and day wrap falling out of it, instead of one BCD tick per
+   second. Packed BCD (0xHHMMSS) is only produced for display: the
+   split into hours, minutes and seconds divides by constants (which
+   compile to multiplies) and each field maps through a 60-entry table.
+   The last conversion is cached, so a display refreshed more often
+   than the clock changes costs a compare. */
+
+#include "dtekv-lib.h"
+
+static const unsigned char bcd60[60] = {
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
+  0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19,
+  0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29,
+  0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+  0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+  0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59
+};
+
+/* Two BCD digits to binary. */
+static unsigned from_bcd(unsigned b)
+{
+  return (b >> 4) * 10 + (b & 0xF);
+}
+
+/* function: clock_set_bcd
+   Description: Set c to the packed BCD time 0xHHMMSS (0x005957 is
+   00:59:57, the labs' starting mytime). Fields out of range wrap. */
+void clock_set_bcd(struct clock *c, unsigned hhmmss)
+{
+  unsigned s = from_bcd(hhmmss >> 16 & 0xFF) * 3600 +
+               from_bcd(hhmmss >> 8 & 0xFF) * 60 +
+               from_bcd(hhmmss & 0xFF);
+
+  c->seconds = s % CLOCK_DAY_SECONDS;
+  c->bcd_seconds = ~0u;             /* Nothing cached yet */
+}
+
+/* function: clock_add
+   Description: Move c by seconds, forwards or backwards, wrapping at
+   midnight. Constant time for any amount. */
+void clock_add(struct clock *c, int seconds)
+{
+  unsigned s;
+
+  if (seconds >= 0) {
+    s = c->seconds + (unsigned) seconds % CLOCK_DAY_SECONDS;
+    if (s >= CLOCK_DAY_SECONDS)
+      s -= CLOCK_DAY_SECONDS;
+  } else {
+    unsigned back = (0u - (unsigned) seconds) % CLOCK_DAY_SECONDS;
+    s = c->seconds >= back ? c->seconds - back
+                           : c->seconds + CLOCK_DAY_SECONDS - back;
+  }
+  c->seconds = s;
+}
+
+/* function: clock_bcd
+   Description: The time of c as packed BCD 0xHHMMSS. */
+unsigned clock_bcd(struct clock *c)
+{
+  unsigned s = c->seconds, h, m;
+
+  if (s != c->bcd_seconds) {
+    h = s / 3600;
+    s -= h * 3600;
+    m = s / 60;
+    s -= m * 60;
+    c->bcd = bcd60[h] << 16 | bcd60[m] << 8 | bcd60[s];
+    c->bcd_seconds = c->seconds;
+  }
+  return c->bcd;
+}
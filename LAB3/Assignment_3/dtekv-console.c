@@ -0,0 +1,264 @@
+/* dtekv-console.c
+
+   Text console on the VGA output, a second sink for print output.
+
+   Characters are 8x8 cells from a packed 1-bit font (8 bytes per
+   glyph, 95 printable ASCII characters), giving 40 columns by 30 rows.
+   A glyph row is expanded to two words of pixels through a nibble
+   mask table, so each character is 16 word stores.
+
+   Scrolling never copies the screen. The two frames of the screen
+   buffer are used as one strip of 60 text rows, and every row is
+   written twice, at r and r + 30. The DMA controller scans out 30 rows
+   starting at row top, so scrolling is one write of its buffer address;
+   when top reaches 30 it drops back to 0, which shows the same picture.
+   The console therefore owns the whole screen buffer: do not mix it
+   with the double-buffered drawing in dtekv-vga.c. */
+
+#include "dtekv-lib.h"
+
+#define VGA_DMA    ((volatile int *) 0x04000100)
+#define DMA_BUFFER      0
+#define DMA_BACKBUFFER  1
+#define DMA_STATUS      3
+
+#define SCREEN      ((unsigned char *) 0x08000000)
+#define CELL        8
+#define ROW_BYTES   (VGA_WIDTH * CELL)    /* One text row of pixels */
+
+/* Glyphs for ' ' to '~'; row bytes top to bottom, bit 7 leftmost. */
+static const unsigned char font[95 * 8] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   /* ' ' */
+  0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x10, 0x00,   /* '!' */
+  0x28, 0x28, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00,   /* '"' */
+  0x28, 0x28, 0x7c, 0x28, 0x7c, 0x28, 0x28, 0x00,   /* '#' */
+  0x10, 0x3c, 0x50, 0x38, 0x14, 0x78, 0x10, 0x00,   /* '$' */
+  0x60, 0x64, 0x08, 0x10, 0x20, 0x4c, 0x0c, 0x00,   /* '%' */
+  0x30, 0x48, 0x50, 0x20, 0x54, 0x48, 0x34, 0x00,   /* '&' */
+  0x10, 0x10, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00,   /* ''' */
+  0x08, 0x10, 0x20, 0x20, 0x20, 0x10, 0x08, 0x00,   /* '(' */
+  0x20, 0x10, 0x08, 0x08, 0x08, 0x10, 0x20, 0x00,   /* ')' */
+  0x00, 0x10, 0x54, 0x38, 0x54, 0x10, 0x00, 0x00,   /* '*' */
+  0x00, 0x10, 0x10, 0x7c, 0x10, 0x10, 0x00, 0x00,   /* '+' */
+  0x00, 0x00, 0x00, 0x00, 0x30, 0x10, 0x20, 0x00,   /* ',' */
+  0x00, 0x00, 0x00, 0x7c, 0x00, 0x00, 0x00, 0x00,   /* '-' */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x30, 0x00,   /* '.' */
+  0x00, 0x04, 0x08, 0x10, 0x20, 0x40, 0x00, 0x00,   /* '/' */
+  0x38, 0x44, 0x4c, 0x54, 0x64, 0x44, 0x38, 0x00,   /* '0' */
+  0x10, 0x30, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00,   /* '1' */
+  0x38, 0x44, 0x04, 0x08, 0x10, 0x20, 0x7c, 0x00,   /* '2' */
+  0x7c, 0x08, 0x10, 0x08, 0x04, 0x44, 0x38, 0x00,   /* '3' */
+  0x08, 0x18, 0x28, 0x48, 0x7c, 0x08, 0x08, 0x00,   /* '4' */
+  0x7c, 0x40, 0x78, 0x04, 0x04, 0x44, 0x38, 0x00,   /* '5' */
+  0x18, 0x20, 0x40, 0x78, 0x44, 0x44, 0x38, 0x00,   /* '6' */
+  0x7c, 0x04, 0x08, 0x10, 0x20, 0x20, 0x20, 0x00,   /* '7' */
+  0x38, 0x44, 0x44, 0x38, 0x44, 0x44, 0x38, 0x00,   /* '8' */
+  0x38, 0x44, 0x44, 0x3c, 0x04, 0x08, 0x30, 0x00,   /* '9' */
+  0x00, 0x30, 0x30, 0x00, 0x30, 0x30, 0x00, 0x00,   /* ':' */
+  0x00, 0x30, 0x30, 0x00, 0x30, 0x10, 0x20, 0x00,   /* ';' */
+  0x08, 0x10, 0x20, 0x40, 0x20, 0x10, 0x08, 0x00,   /* '<' */
+  0x00, 0x00, 0x7c, 0x00, 0x7c, 0x00, 0x00, 0x00,   /* '=' */
+  0x20, 0x10, 0x08, 0x04, 0x08, 0x10, 0x20, 0x00,   /* '>' */
+  0x38, 0x44, 0x04, 0x08, 0x10, 0x00, 0x10, 0x00,   /* '?' */
+  0x38, 0x44, 0x04, 0x34, 0x54, 0x54, 0x38, 0x00,   /* '@' */
+  0x38, 0x44, 0x44, 0x7c, 0x44, 0x44, 0x44, 0x00,   /* 'A' */
+  0x78, 0x44, 0x44, 0x78, 0x44, 0x44, 0x78, 0x00,   /* 'B' */
+  0x38, 0x44, 0x40, 0x40, 0x40, 0x44, 0x38, 0x00,   /* 'C' */
+  0x70, 0x48, 0x44, 0x44, 0x44, 0x48, 0x70, 0x00,   /* 'D' */
+  0x7c, 0x40, 0x40, 0x78, 0x40, 0x40, 0x7c, 0x00,   /* 'E' */
+  0x7c, 0x40, 0x40, 0x78, 0x40, 0x40, 0x40, 0x00,   /* 'F' */
+  0x38, 0x44, 0x40, 0x5c, 0x44, 0x44, 0x3c, 0x00,   /* 'G' */
+  0x44, 0x44, 0x44, 0x7c, 0x44, 0x44, 0x44, 0x00,   /* 'H' */
+  0x38, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00,   /* 'I' */
+  0x1c, 0x08, 0x08, 0x08, 0x08, 0x48, 0x30, 0x00,   /* 'J' */
+  0x44, 0x48, 0x50, 0x60, 0x50, 0x48, 0x44, 0x00,   /* 'K' */
+  0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7c, 0x00,   /* 'L' */
+  0x44, 0x6c, 0x54, 0x54, 0x44, 0x44, 0x44, 0x00,   /* 'M' */
+  0x44, 0x44, 0x64, 0x54, 0x4c, 0x44, 0x44, 0x00,   /* 'N' */
+  0x38, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00,   /* 'O' */
+  0x78, 0x44, 0x44, 0x78, 0x40, 0x40, 0x40, 0x00,   /* 'P' */
+  0x38, 0x44, 0x44, 0x44, 0x54, 0x48, 0x34, 0x00,   /* 'Q' */
+  0x78, 0x44, 0x44, 0x78, 0x50, 0x48, 0x44, 0x00,   /* 'R' */
+  0x3c, 0x40, 0x40, 0x38, 0x04, 0x04, 0x78, 0x00,   /* 'S' */
+  0x7c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00,   /* 'T' */
+  0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00,   /* 'U' */
+  0x44, 0x44, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00,   /* 'V' */
+  0x44, 0x44, 0x44, 0x54, 0x54, 0x54, 0x28, 0x00,   /* 'W' */
+  0x44, 0x44, 0x28, 0x10, 0x28, 0x44, 0x44, 0x00,   /* 'X' */
+  0x44, 0x44, 0x28, 0x10, 0x10, 0x10, 0x10, 0x00,   /* 'Y' */
+  0x7c, 0x04, 0x08, 0x10, 0x20, 0x40, 0x7c, 0x00,   /* 'Z' */
+  0x38, 0x20, 0x20, 0x20, 0x20, 0x20, 0x38, 0x00,   /* '[' */
+  0x00, 0x40, 0x20, 0x10, 0x08, 0x04, 0x00, 0x00,   /* 'backslash' */
+  0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00,   /* ']' */
+  0x10, 0x28, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00,   /* '^' */
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7c, 0x00,   /* '_' */
+  0x20, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,   /* '`' */
+  0x00, 0x00, 0x38, 0x04, 0x3c, 0x44, 0x3c, 0x00,   /* 'a' */
+  0x40, 0x40, 0x58, 0x64, 0x44, 0x44, 0x78, 0x00,   /* 'b' */
+  0x00, 0x00, 0x38, 0x40, 0x40, 0x44, 0x38, 0x00,   /* 'c' */
+  0x04, 0x04, 0x34, 0x4c, 0x44, 0x44, 0x3c, 0x00,   /* 'd' */
+  0x00, 0x00, 0x38, 0x44, 0x7c, 0x40, 0x38, 0x00,   /* 'e' */
+  0x18, 0x24, 0x20, 0x70, 0x20, 0x20, 0x20, 0x00,   /* 'f' */
+  0x00, 0x00, 0x3c, 0x44, 0x44, 0x3c, 0x04, 0x38,   /* 'g' */
+  0x40, 0x40, 0x58, 0x64, 0x44, 0x44, 0x44, 0x00,   /* 'h' */
+  0x10, 0x00, 0x30, 0x10, 0x10, 0x10, 0x38, 0x00,   /* 'i' */
+  0x08, 0x00, 0x18, 0x08, 0x08, 0x08, 0x48, 0x30,   /* 'j' */
+  0x40, 0x40, 0x48, 0x50, 0x60, 0x50, 0x48, 0x00,   /* 'k' */
+  0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x38, 0x00,   /* 'l' */
+  0x00, 0x00, 0x68, 0x54, 0x54, 0x44, 0x44, 0x00,   /* 'm' */
+  0x00, 0x00, 0x58, 0x64, 0x44, 0x44, 0x44, 0x00,   /* 'n' */
+  0x00, 0x00, 0x38, 0x44, 0x44, 0x44, 0x38, 0x00,   /* 'o' */
+  0x00, 0x00, 0x78, 0x44, 0x44, 0x78, 0x40, 0x40,   /* 'p' */
+  0x00, 0x00, 0x3c, 0x44, 0x44, 0x3c, 0x04, 0x04,   /* 'q' */
+  0x00, 0x00, 0x58, 0x64, 0x40, 0x40, 0x40, 0x00,   /* 'r' */
+  0x00, 0x00, 0x3c, 0x40, 0x38, 0x04, 0x78, 0x00,   /* 's' */
+  0x20, 0x20, 0x70, 0x20, 0x20, 0x24, 0x18, 0x00,   /* 't' */
+  0x00, 0x00, 0x44, 0x44, 0x44, 0x4c, 0x34, 0x00,   /* 'u' */
+  0x00, 0x00, 0x44, 0x44, 0x44, 0x28, 0x10, 0x00,   /* 'v' */
+  0x00, 0x00, 0x44, 0x44, 0x54, 0x54, 0x28, 0x00,   /* 'w' */
+  0x00, 0x00, 0x44, 0x28, 0x10, 0x28, 0x44, 0x00,   /* 'x' */
+  0x00, 0x00, 0x44, 0x44, 0x44, 0x3c, 0x04, 0x38,   /* 'y' */
+  0x00, 0x00, 0x7c, 0x08, 0x10, 0x20, 0x7c, 0x00,   /* 'z' */
+  0x08, 0x10, 0x10, 0x20, 0x10, 0x10, 0x08, 0x00,   /* '{' */
+  0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00,   /* '|' */
+  0x20, 0x10, 0x10, 0x08, 0x10, 0x10, 0x20, 0x00,   /* '}' */
+  0x00, 0x00, 0x20, 0x54, 0x08, 0x00, 0x00, 0x00,   /* '~' */
+
+};
+
+/* Nibble to a word with 0xFF in each byte whose pixel is set; byte 0
+   is the leftmost pixel (the bus is little endian). */
+static const unsigned nibble_mask[16] = {
+  0x00000000, 0xFF000000, 0x00FF0000, 0xFFFF0000,
+  0x0000FF00, 0xFF00FF00, 0x00FFFF00, 0xFFFFFF00,
+  0x000000FF, 0xFF0000FF, 0x00FF00FF, 0xFFFF00FF,
+  0x0000FFFF, 0xFF00FFFF, 0x00FFFFFF, 0xFFFFFFFF
+};
+
+static unsigned fg_word, bg_word;   /* Colours repeated in each byte */
+static unsigned col, row;           /* Cursor, row relative to the top */
+static unsigned top;                /* First text row scanned out, 0-29 */
+static int scroll_dirty;            /* top changed, DMA not told yet */
+
+/* The two copies of on-screen text row r. */
+static unsigned char *row_base(unsigned r)
+{
+  unsigned p = top + r;
+
+  if (p >= VGACON_ROWS)
+    p -= VGACON_ROWS;
+  return SCREEN + p * ROW_BYTES;
+}
+
+/* Point the DMA controller at row top, unless a swap is still pending;
+   then vgacon_write or vgacon_flush tries again later. */
+static void show_top(void)
+{
+  if (VGA_DMA[DMA_STATUS] & 1)
+    return;
+  VGA_DMA[DMA_BACKBUFFER] = (int) (SCREEN + top * ROW_BYTES);
+  VGA_DMA[DMA_BUFFER] = 1;
+  scroll_dirty = 0;
+}
+
+static void clear_row(unsigned r)
+{
+  unsigned *p = (unsigned *) row_base(r);
+  unsigned *q = (unsigned *) ((unsigned char *) p + VGACON_ROWS * ROW_BYTES);
+
+  for (int i = 0; i < ROW_BYTES / 4; i++) {
+    p[i] = bg_word;
+    q[i] = bg_word;
+  }
+}
+
+static void draw_glyph(unsigned c)
+{
+  const unsigned char *g = font + (c - ' ') * 8;
+  unsigned *p = (unsigned *) (row_base(row) + col * CELL);
+  unsigned *q = (unsigned *) ((unsigned char *) p + VGACON_ROWS * ROW_BYTES);
+
+  for (int y = 0; y < CELL; y++) {
+    unsigned m0 = nibble_mask[g[y] >> 4], m1 = nibble_mask[g[y] & 15];
+    unsigned w0 = (fg_word & m0) | (bg_word & ~m0);
+    unsigned w1 = (fg_word & m1) | (bg_word & ~m1);
+    p[0] = w0;
+    p[1] = w1;
+    q[0] = w0;
+    q[1] = w1;
+    p += VGA_WIDTH / 4;
+    q += VGA_WIDTH / 4;
+  }
+}
+
+static void newline(void)
+{
+  col = 0;
+  if (row < VGACON_ROWS - 1) {
+    row++;
+    return;
+  }
+  if (++top == VGACON_ROWS)
+    top = 0;
+  clear_row(row);
+  scroll_dirty = 1;
+}
+
+/* function: vgacon_init
+   Description: Clear the screen to bg and put the cursor top left.
+   Colours are VGA_RGB values. */
+void vgacon_init(unsigned fg, unsigned bg)
+{
+  fg_word = (fg & 0xFF) * 0x01010101u;
+  bg_word = (bg & 0xFF) * 0x01010101u;
+  col = row = top = 0;
+  for (unsigned r = 0; r < VGACON_ROWS; r++)
+    clear_row(r);
+  while (VGA_DMA[DMA_STATUS] & 1)
+    ;
+  show_top();
+}
+
+/* function: vgacon_write
+   Description: Draw len characters at the cursor. Handles newline,
+   carriage return, backspace and tab; other control characters and
+   non-ASCII bytes are drawn as '?'. */
+void vgacon_write(const char *buf, unsigned len)
+{
+  while (len-- != 0) {
+    unsigned c = (unsigned char) *buf++;
+
+    if (c == '\n') {
+      newline();
+    } else if (c == '\r') {
+      col = 0;
+    } else if (c == '\b') {
+      if (col)
+        col--;
+    } else if (c == '\t') {
+      col = (col + 8) & ~7u;
+      if (col >= VGACON_COLS)
+        newline();
+    } else {
+      if (c < ' ' || c > '~')
+        c = '?';
+      if (col == VGACON_COLS)
+        newline();
+      draw_glyph(c);
+      col++;
+    }
+  }
+  if (scroll_dirty)
+    show_top();
+}
+
+/* function: vgacon_flush
+   Description: Wait until the latest scroll position is on screen. */
+void vgacon_flush(void)
+{
+  while (scroll_dirty) {
+    while (VGA_DMA[DMA_STATUS] & 1)
+      ;
+    show_top();
+  }
+}
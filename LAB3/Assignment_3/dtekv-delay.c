@@ -0,0 +1,79 @@
+/* dtekv-delay.c
+
+   Delays measured on the mcycle counter instead of calibrated loops.
+
+   Every wait is a deadline in cycles, so the loop's own cost does not
+   add up. A wait shorter than DELAY_SPIN_CYCLES spins on mcycle. A
+   longer one, when the timer service is running and interrupts are
+   enabled, parks a soft timer just before the deadline and sits in
+   wfi until some interrupt arrives, then spins out the rest. With
+   interrupts off (inside a handler, say) it only spins.
+   Tasks that can let others run should use task_sleep instead. */
+
+#include "dtekv-lib.h"
+
+static struct soft_timer wake_timer;
+
+static void wake(unsigned arg)
+{
+}
+
+/* function: sleep_until
+   Description: Wait until mcycle_now() reaches cycle (at most about
+   71 s ahead). */
+void sleep_until(unsigned cycle)
+{
+  unsigned tick = timer_tick_cycles();
+  int left = (int) (cycle - mcycle_now());
+
+  if (tick && left > DELAY_SPIN_CYCLES + (int) tick) {
+    unsigned flags = irq_save();
+    while ((flags & 8) &&
+           (left = (int) (cycle - mcycle_now())) > DELAY_SPIN_CYCLES + (int) tick) {
+      /* Re-armed every pass, in case something else woke us first */
+      timer_start(&wake_timer, (left - DELAY_SPIN_CYCLES) / tick, 0, wake, 0);
+      asm volatile ("wfi");
+      irq_restore(flags);                 /* Take the interrupt */
+      flags = irq_save();
+    }
+    timer_cancel(&wake_timer);
+    irq_restore(flags);
+  }
+  while ((int) (cycle - mcycle_now()) > 0)
+    ;
+}
+
+/* function: delay_cycles
+   Description: Wait cycles clock cycles. */
+void delay_cycles(unsigned cycles)
+{
+  sleep_until(mcycle_now() + cycles);
+}
+
+/* function: delay_us
+   Description: Wait us microseconds. */
+void delay_us(unsigned us)
+{
+  unsigned deadline = mcycle_now();
+
+  while (us > 1000000) {                 /* Keep each step inside 71 s */
+    deadline += 1000000 * DELAY_CYCLES_PER_US;
+    sleep_until(deadline);
+    us -= 1000000;
+  }
+  sleep_until(deadline + us * DELAY_CYCLES_PER_US);
+}
+
+/* function: delay_ms
+   Description: Wait ms milliseconds. */
+void delay_ms(unsigned ms)
+{
+  unsigned deadline = mcycle_now();
+
+  while (ms > 1000) {
+    deadline += 1000 * 1000 * DELAY_CYCLES_PER_US;
+    sleep_until(deadline);
+    ms -= 1000;
+  }
+  sleep_until(deadline + ms * 1000 * DELAY_CYCLES_PER_US);
+}
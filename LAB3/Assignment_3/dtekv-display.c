@@ -0,0 +1,166 @@
+/* dtekv-display.c
+
+   Driver for the six 7-segment displays at 0x04000050.
+
+   Characters map to segments through a constant table, so there is no
+   switch per digit. The driver keeps a shadow copy of the six segment
+   registers and only writes a register whose pattern changes: a clock
+   ticking once a second usually touches one digit, not six. Everything
+   above display_put is a batch of those writes. */
+
+#include "dtekv-lib.h"
+
+#define DISPLAYS ((volatile int *) 0x04000050)
+#define DISPLAY_STRIDE 4    /* Words between digit registers (16 bytes) */
+
+/* Segment bits, active high here; the hardware is active low. */
+#define SA 0x01
+#define SB 0x02
+#define SC 0x04
+#define SD 0x08
+#define SE 0x10
+#define SF 0x20
+#define SG 0x40
+#define DP 0x80
+
+/* Glyphs for 7-bit ASCII; 0 (blank) where nothing readable fits.
+   Letters are the usual 7-segment approximations, lower case shares
+   the upper case shape. */
+static const unsigned char glyph[128] = {
+  ['0'] = SA|SB|SC|SD|SE|SF,    ['1'] = SB|SC,
+  ['2'] = SA|SB|SD|SE|SG,       ['3'] = SA|SB|SC|SD|SG,
+  ['4'] = SB|SC|SF|SG,          ['5'] = SA|SC|SD|SF|SG,
+  ['6'] = SA|SC|SD|SE|SF|SG,    ['7'] = SA|SB|SC,
+  ['8'] = SA|SB|SC|SD|SE|SF|SG, ['9'] = SA|SB|SC|SD|SF|SG,
+  ['A'] = SA|SB|SC|SE|SF|SG,    ['a'] = SA|SB|SC|SE|SF|SG,
+  ['B'] = SC|SD|SE|SF|SG,       ['b'] = SC|SD|SE|SF|SG,
+  ['C'] = SA|SD|SE|SF,          ['c'] = SD|SE|SG,
+  ['D'] = SB|SC|SD|SE|SG,       ['d'] = SB|SC|SD|SE|SG,
+  ['E'] = SA|SD|SE|SF|SG,       ['e'] = SA|SD|SE|SF|SG,
+  ['F'] = SA|SE|SF|SG,          ['f'] = SA|SE|SF|SG,
+  ['G'] = SA|SC|SD|SE|SF,       ['g'] = SA|SC|SD|SE|SF,
+  ['H'] = SB|SC|SE|SF|SG,       ['h'] = SC|SE|SF|SG,
+  ['I'] = SE|SF,                ['i'] = SE,
+  ['J'] = SB|SC|SD|SE,          ['j'] = SB|SC|SD,
+  ['K'] = SB|SC|SE|SF|SG,       ['k'] = SB|SC|SE|SF|SG,
+  ['L'] = SD|SE|SF,             ['l'] = SD|SE|SF,
+  ['M'] = SA|SC|SE,             ['m'] = SA|SC|SE,
+  ['N'] = SC|SE|SG,             ['n'] = SC|SE|SG,
+  ['O'] = SA|SB|SC|SD|SE|SF,    ['o'] = SC|SD|SE|SG,
+  ['P'] = SA|SB|SE|SF|SG,       ['p'] = SA|SB|SE|SF|SG,
+  ['Q'] = SA|SB|SC|SF|SG,       ['q'] = SA|SB|SC|SF|SG,
+  ['R'] = SE|SG,                ['r'] = SE|SG,
+  ['S'] = SA|SC|SD|SF|SG,       ['s'] = SA|SC|SD|SF|SG,
+  ['T'] = SD|SE|SF|SG,          ['t'] = SD|SE|SF|SG,
+  ['U'] = SB|SC|SD|SE|SF,       ['u'] = SC|SD|SE,
+  ['V'] = SC|SD|SE,             ['v'] = SC|SD|SE,
+  ['W'] = SB|SD|SF,             ['w'] = SB|SD|SF,
+  ['X'] = SB|SC|SE|SF|SG,       ['x'] = SB|SC|SE|SF|SG,
+  ['Y'] = SB|SC|SD|SF|SG,       ['y'] = SB|SC|SD|SF|SG,
+  ['Z'] = SA|SB|SD|SE|SG,       ['z'] = SA|SB|SD|SE|SG,
+  ['-'] = SG, ['_'] = SD, ['='] = SD|SG, ['.'] = DP,
+  ['"'] = SB|SF, ['\''] = SB, ['['] = SA|SD|SE|SF, [']'] = SA|SB|SC|SD,
+};
+
+static const char hex_chars[16] = "0123456789ABCDEF";
+
+/* Last pattern written to each register; ~0 forces the next write. */
+static unsigned shadow[DISPLAY_DIGITS] = { ~0u, ~0u, ~0u, ~0u, ~0u, ~0u };
+static unsigned writes;
+
+/* function: display_put
+   Description: Show raw segments (active high, bit 0 = a ... bit 6 = g,
+   bit 7 = decimal point) at pos, touching the register only if the
+   pattern changes. */
+void display_put(unsigned pos, unsigned segments)
+{
+  unsigned pattern = ~segments & 0xFF;
+
+  if (pos >= DISPLAY_DIGITS || shadow[pos] == pattern)
+    return;
+  shadow[pos] = pattern;
+  DISPLAYS[pos * DISPLAY_STRIDE] = pattern;
+  writes++;
+}
+
+/* function: display_char
+   Description: Show character c at pos; blank if it has no glyph. */
+void display_char(unsigned pos, char c)
+{
+  display_put(pos, glyph[c & 0x7F]);
+}
+
+/* function: display_bcd
+   Description: Show the six BCD digits of bcd, e.g. 0xHHMMSS from
+   clock_bcd. Nibbles above 9 show as hex letters. */
+void display_bcd(unsigned bcd)
+{
+  for (unsigned pos = 0; pos < DISPLAY_DIGITS; pos++, bcd >>= 4)
+    display_put(pos, glyph[(unsigned char) hex_chars[bcd & 0xF]]);
+}
+
+/* function: display_hex
+   Description: Show the low 24 bits of value in hex. */
+void display_hex(unsigned value)
+{
+  display_bcd(value);
+}
+
+/* function: display_text
+   Description: Show up to six characters of text, left aligned,
+   blanking the rest. */
+void display_text(const char *text)
+{
+  for (int pos = DISPLAY_DIGITS - 1; pos >= 0; pos--) {
+    display_char(pos, *text);
+    if (*text)
+      text++;
+  }
+}
+
+/* function: display_scroll_init
+   Description: Prepare text to scroll in from the right, one character
+   per display_scroll_step, with a blank screen between repeats. */
+void display_scroll_init(struct display_scroll *s, const char *text)
+{
+  unsigned len = 0;
+
+  while (text[len])
+    len++;
+  s->text = text;
+  s->len = len;
+  s->offset = 0;
+}
+
+/* function: display_scroll_step
+   Description: Show the next window of the scrolling text. */
+void display_scroll_step(struct display_scroll *s)
+{
+  unsigned total = s->len + DISPLAY_DIGITS;   /* Leading blanks, then text */
+  unsigned i = s->offset;
+
+  for (int pos = DISPLAY_DIGITS - 1; pos >= 0; pos--) {
+    char c = i >= DISPLAY_DIGITS ? s->text[i - DISPLAY_DIGITS] : ' ';
+    display_char(pos, c);
+    if (++i == total)
+      i = 0;
+  }
+  if (++s->offset == total)
+    s->offset = 0;
+}
+
+/* function: display_invalidate
+   Description: Forget the shadow so the next update rewrites every
+   digit, e.g. after something else wrote the registers. */
+void display_invalidate(void)
+{
+  for (int pos = 0; pos < DISPLAY_DIGITS; pos++)
+    shadow[pos] = ~0u;
+}
+
+/* function: display_writes
+   Description: Segment register writes made so far. */
+unsigned display_writes(void)
+{
+  return writes;
+}
@@ -0,0 +1,217 @@
+/* dtekv-emulate.c
+
+   Trap-and-emulate for instructions the core may not execute itself:
+   the M extension (mul, mulh, mulhsu, mulhu, div, divu, rem, remu),
+   which raises an illegal-instruction trap on a core built without it,
+   and loads and stores to misaligned addresses. _isr_routine passes
+   the faulting word and the register frame it saved; trap_emulate
+   computes the result into the frame, and the trap returns past the
+   instruction. Anything it turns down goes on to handle_exception.
+
+   A mul in here would trap straight back into trap_emulate, forever,
+   so products and quotients are built from shifts and adds and there
+   is no `*`, `/` or `%` below. The Makefile compiles this file with
+   -march=rv32i_zicsr, so GCC cannot bring one in either, and fails the
+   build if objdump finds an M instruction in it. Each emulated opcode
+   counts how often it trapped and the cycles spent decoding and
+   computing it. The register save and restore around the trap come on
+   top. */
+
+#include "dtekv-lib.h"
+
+#define OP_LOAD  0x03
+#define OP_STORE 0x23
+#define OP_REG   0x33
+#define FUNCT7_M 0x01
+
+static struct emu_stat emu_table[EMU_OPS];
+
+static const char *const emu_names[EMU_OPS] = {
+  "mul", "mulh", "mulhsu", "mulhu", "div", "divu", "rem", "remu",
+  "misaligned load", "misaligned store"
+};
+
+/* Register r in the frame: x1 is at regs[0], x0 reads as zero. */
+static inline unsigned reg_get(const unsigned *regs, unsigned r)
+{
+  return r ? regs[r - 1] : 0;
+}
+
+/* Writes to x0 are discarded, and so are writes to sp, which
+   _isr_routine does not restore from the frame. */
+static inline void reg_set(unsigned *regs, unsigned r, unsigned v)
+{
+  if (r > 2 || r == 1)
+    regs[r - 1] = v;
+}
+
+/* 64-bit product of a and b by shift and add. */
+static unsigned long long umul64(unsigned a, unsigned b)
+{
+  unsigned long long acc = 0, x = a;
+
+  while (b) {
+    if (b & 1)
+      acc += x;
+    x <<= 1;
+    b >>= 1;
+  }
+  return acc;
+}
+
+/* n / d and n % d for d != 0, one quotient bit per step. */
+static unsigned udivmod(unsigned n, unsigned d, unsigned *rem)
+{
+  unsigned q = 0, r = 0;
+
+  for (int i = 31; i >= 0; i--) {
+    unsigned carry = r >> 31;
+    r = r << 1 | (n >> i & 1);
+    if (carry || r >= d) {
+      r -= d;
+      q |= 1u << i;
+    }
+  }
+  *rem = r;
+  return q;
+}
+
+/* One M-extension operation with the results RISC-V specifies for
+   division by zero and for the most negative number divided by -1. */
+static unsigned m_op(unsigned funct3, unsigned a, unsigned b)
+{
+  unsigned long long p;
+  unsigned q, r, ua, ub;
+
+  switch (funct3) {
+  case EMU_MUL:
+    return (unsigned) umul64(a, b);
+  case EMU_MULH:
+    p = umul64(a, b);
+    return (unsigned) (p >> 32) - ((int) a < 0 ? b : 0) - ((int) b < 0 ? a : 0);
+  case EMU_MULHSU:
+    p = umul64(a, b);
+    return (unsigned) (p >> 32) - ((int) a < 0 ? b : 0);
+  case EMU_MULHU:
+    return (unsigned) (umul64(a, b) >> 32);
+  case EMU_DIVU:
+    return b ? udivmod(a, b, &r) : ~0u;
+  case EMU_REMU:
+    if (b == 0)
+      return a;
+    udivmod(a, b, &r);
+    return r;
+  }
+
+  /* div and rem: divide the magnitudes, then fix the signs */
+  if (b == 0)
+    return funct3 == EMU_DIV ? ~0u : a;
+  ua = (int) a < 0 ? 0u - a : a;
+  ub = (int) b < 0 ? 0u - b : b;
+  q = udivmod(ua, ub, &r);
+  if (funct3 == EMU_DIV)
+    return ((a ^ b) >> 31) ? 0u - q : q;
+  return (int) a < 0 ? 0u - r : r;
+}
+
+/* Byte-wise access of 1, 2 or 4 bytes, little-endian. */
+static unsigned load_bytes(unsigned addr, unsigned size)
+{
+  volatile unsigned char *p = (volatile unsigned char *) addr;
+  unsigned v = 0;
+
+  for (unsigned i = size; i-- != 0; )
+    v = v << 8 | p[i];
+  return v;
+}
+
+static void store_bytes(unsigned addr, unsigned size, unsigned v)
+{
+  volatile unsigned char *p = (volatile unsigned char *) addr;
+
+  for (unsigned i = 0; i < size; i++, v >>= 8)
+    p[i] = v;
+}
+
+/* function: trap_emulate
+   Description: Emulate insn against regs, the trap frame (x1 in
+   regs[0] through x31 in regs[30]). Returns the EMU_* operation, or -1
+   if insn is not one this file handles; regs is then untouched. */
+int trap_emulate(unsigned insn, unsigned *regs)
+{
+  unsigned start = mcycle_now();
+  unsigned rd = insn >> 7 & 0x1F, funct3 = insn >> 12 & 7;
+  unsigned rs1 = insn >> 15 & 0x1F, rs2 = insn >> 20 & 0x1F;
+  unsigned addr, size, v;
+  int op;
+
+  switch (insn & 0x7F) {
+  case OP_REG:
+    if (insn >> 25 != FUNCT7_M)
+      return -1;
+    reg_set(regs, rd, m_op(funct3, reg_get(regs, rs1), reg_get(regs, rs2)));
+    op = funct3;
+    break;
+  case OP_LOAD:
+    size = 1u << (funct3 & 3);
+    if ((funct3 & 3) == 3 || funct3 > 5)
+      return -1;
+    addr = reg_get(regs, rs1) + ((int) insn >> 20);
+    v = load_bytes(addr, size);
+    if (funct3 == 0)
+      v = (int) (v << 24) >> 24;           /* lb */
+    else if (funct3 == 1)
+      v = (int) (v << 16) >> 16;           /* lh */
+    reg_set(regs, rd, v);
+    op = EMU_LOAD;
+    break;
+  case OP_STORE:
+    if (funct3 > 2)
+      return -1;
+    addr = reg_get(regs, rs1) + ((int) (insn & 0xFE000000) >> 20 | rd);
+    store_bytes(addr, 1u << funct3, reg_get(regs, rs2));
+    op = EMU_STORE;
+    break;
+  default:
+    return -1;
+  }
+
+  emu_table[op].count++;
+  emu_table[op].cycles += mcycle_now() - start;
+  return op;
+}
+
+/* function: trap_emulate_stats
+   Description: Per-operation counters, indexed by EMU_*. */
+const struct emu_stat *trap_emulate_stats(void)
+{
+  return emu_table;
+}
+
+/* function: trap_emulate_reset
+   Description: Zero the counters. */
+void trap_emulate_reset(void)
+{
+  memset(emu_table, 0, sizeof(emu_table));
+}
+
+/* function: trap_emulate_dump
+   Description: Print each operation that was emulated, with its count
+   and average cycles. Prints nothing if none was. */
+void trap_emulate_dump(void)
+{
+  unsigned r;
+
+  for (int i = 0; i < EMU_OPS; i++) {
+    const struct emu_stat *e = &emu_table[i];
+    if (e->count == 0)
+      continue;
+    print("emulated ");
+    print(emu_names[i]);
+    print(": ");
+    print_dec(e->count);
+    print(" times, ");
+    print_dec(udivmod(e->cycles, e->count, &r));
+    print(" cycles each\n");
+  }
+}
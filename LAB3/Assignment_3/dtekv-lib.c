@@ -3,53 +3,532 @@
 #define JTAG_UART ((volatile unsigned int*) 0x04000040)
 #define JTAG_CTRL ((volatile unsigned int*) 0x04000044)
 
-void printc(char s)
+#define JTAG_CTRL_RE     0x1            /* Read interrupt enable */
+#define JTAG_CTRL_WE     0x2            /* Write interrupt enable */
+#define JTAG_WSPACE(c)   ((c) >> 16)    /* Free slots in the write FIFO */
+#define JTAG_RVALID      0x8000         /* Data register held a character */
+
+/*
+ * Transmit ring buffer. The writer only moves uart_tx_head and the
+ * drain (uart_tx_kick) only moves uart_tx_tail, except under the
+ * overwrite policy where the writer also discards the oldest byte;
+ * that case runs with interrupts masked.
+ */
+static volatile char uart_tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile unsigned uart_tx_head = 0;
+static volatile unsigned uart_tx_tail = 0;
+static volatile unsigned uart_tx_lost = 0;
+static volatile int uart_tx_draining = 0;
+static int uart_tx_policy = UART_TX_UNBUFFERED;
+static int console_sinks = CONSOLE_UART;
+static unsigned uart_ctrl = 0;          /* Interrupt enables last written */
+
+/* Receive ring: uart_rx_isr is the only producer and uart_getc the
+   only consumer, so neither masks interrupts. */
+RING_DECLARE(uart_rx_ring, char, UART_RX_BUFFER_SIZE)
+
+static struct uart_rx_ring uart_rx;
+
+/* Move as many buffered bytes into the JTAG FIFO as it has room for,
+   reading the write-space count once per burst. Leaves the write
+   interrupt enabled while bytes remain so the ISR finishes the job. */
+static void uart_tx_kick(void)
+{
+  unsigned flags = irq_save();
+  unsigned tail = uart_tx_tail;
+  unsigned head = uart_tx_head;
+
+  while (tail != head) {
+    unsigned space = JTAG_WSPACE(*JTAG_CTRL);
+    if (space == 0)
+      break;
+    while (space-- != 0 && tail != head) {
+      *JTAG_UART = uart_tx_buffer[tail & (UART_TX_BUFFER_SIZE - 1)];
+      tail++;
+    }
+  }
+  uart_tx_tail = tail;
+
+  if (tail != head && !uart_tx_draining) {
+    uart_tx_draining = 1;
+    *JTAG_CTRL = uart_ctrl |= JTAG_CTRL_WE;
+  } else if (tail == head && uart_tx_draining) {
+    uart_tx_draining = 0;
+    *JTAG_CTRL = uart_ctrl &= ~JTAG_CTRL_WE;
+  }
+  irq_restore(flags);
+}
+
+/* Append one byte to the ring, applying the full-buffer policy. The
+   check, the store and the head update run with interrupts masked, so
+   print* may also be called from interrupt context without a nested
+   writer claiming the same slot. */
+static void uart_tx_put(char c)
+{
+  for (;;) {
+    unsigned flags = irq_save();
+    if (uart_tx_head - uart_tx_tail < UART_TX_BUFFER_SIZE) {
+      uart_tx_buffer[uart_tx_head & (UART_TX_BUFFER_SIZE - 1)] = c;
+      uart_tx_head++;
+      irq_restore(flags);
+      return;
+    }
+    if (uart_tx_policy == UART_TX_DROP) {
+      uart_tx_lost++;
+      irq_restore(flags);
+      return;
+    }
+    if (uart_tx_policy == UART_TX_OVERWRITE) {
+      uart_tx_tail++;
+      uart_tx_lost++;
+      irq_restore(flags);
+      continue;
+    }
+    irq_restore(flags);
+    /* UART_TX_BLOCK: poll the FIFO ourselves so this also works from
+       trap context, where the UART interrupt cannot fire. */
+    uart_tx_kick();
+  }
+}
+
+/* function: uart_tx_init
+   Description: Select the transmit policy. UART_TX_UNBUFFERED restores
+   the original busy-wait per character; any other policy routes output
+   through the ring buffer. Call before enabling interrupts. */
+void uart_tx_init(int policy)
 {
+  uart_tx_flush();
+  uart_tx_policy = policy;
+  uart_tx_lost = 0;
+  if (policy != UART_TX_UNBUFFERED) {
+    unsigned bit = 1u << JTAG_UART_IRQ;
+    asm volatile ("csrs mie, %0" :: "r"(bit));
+  }
+}
+
+/* function: uart_tx_isr
+   Description: Drain step for the JTAG UART write interrupt. Safe to
+   call from any interrupt, e.g. the timer, on boards where the UART
+   interrupt line is not connected. */
+void uart_tx_isr(void)
+{
+  if (uart_tx_head != uart_tx_tail)
+    uart_tx_kick();
+  else if (uart_tx_draining) {
+    uart_tx_draining = 0;
+    *JTAG_CTRL = uart_ctrl &= ~JTAG_CTRL_WE;
+  }
+}
+
+/* function: uart_tx_flush
+   Description: Wait until every buffered byte has reached the FIFO. */
+void uart_tx_flush(void)
+{
+  while (uart_tx_head != uart_tx_tail)
+    uart_tx_kick();
+}
+
+/* Number of bytes discarded by the drop or overwrite policies. */
+unsigned uart_tx_dropped(void)
+{
+  return uart_tx_lost;
+}
+
+/* function: uart_rx_init
+   Description: Enable the JTAG UART read interrupt. Characters typed on
+   the host collect in a ring until uart_getc; the handler for
+   JTAG_UART_IRQ must call uart_rx_isr. */
+void uart_rx_init(void)
+{
+  unsigned bit = 1u << JTAG_UART_IRQ;
+  unsigned flags = irq_save();
+
+  *JTAG_CTRL = uart_ctrl |= JTAG_CTRL_RE;
+  irq_restore(flags);
+  asm volatile ("csrs mie, %0" :: "r"(bit));
+}
+
+/* function: uart_rx_isr
+   Description: Move every character in the read FIFO into the receive
+   ring. The FIFO is always emptied, so the read interrupt clears even
+   when the ring is full and characters have to be dropped. Like
+   uart_tx_isr, safe to call from any interrupt. */
+void uart_rx_isr(void)
+{
+  unsigned data;
+
+  while ((data = *JTAG_UART) & JTAG_RVALID) {
+    char c = data & 0xFF;
+    uart_rx_ring_put(&uart_rx, &c);
+  }
+}
+
+/* function: uart_getc
+   Description: Next received character, or -1 if none is waiting. */
+int uart_getc(void)
+{
+  char c;
+
+  if (!uart_rx_ring_get(&uart_rx, &c))
+    return -1;
+  return (unsigned char) c;
+}
+
+/* Received characters discarded because the ring was full. */
+unsigned uart_rx_dropped(void)
+{
+  return uart_rx.lost;
+}
+
+static void uart_putc(char s)
+{
+  if (uart_tx_policy == UART_TX_UNBUFFERED) {
     while (((*JTAG_CTRL)&0xffff0000) == 0);
     *JTAG_UART = s;
+    return;
+  }
+  uart_tx_put(s);
+  if (!uart_tx_draining)
+    uart_tx_kick();
+}
+
+/* function: uart_write
+   Description: Queue len bytes and start a single FIFO burst. */
+void uart_write(const char *buf, unsigned len)
+{
+  if (uart_tx_policy == UART_TX_UNBUFFERED) {
+    while (len-- != 0)
+      uart_putc(*buf++);
+    return;
+  }
+  while (len-- != 0)
+    uart_tx_put(*buf++);
+  if (!uart_tx_draining)
+    uart_tx_kick();
 }
 
-void print(char *s)
+/* function: console_sink
+   Description: Send print output to CONSOLE_UART, CONSOLE_VGA or
+   CONSOLE_BOTH. Call vgacon_init before selecting the VGA. */
+void console_sink(int sinks)
+{
+  console_sinks = sinks;
+}
+
+/* function: console_write
+   Description: Write len bytes to every selected sink. */
+void console_write(const char *buf, unsigned len)
+{
+  if (console_sinks & CONSOLE_VGA)
+    vgacon_write(buf, len);
+  if (console_sinks & CONSOLE_UART)
+    uart_write(buf, len);
+}
+
+void printc(char s)
+{
+  if (console_sinks & CONSOLE_VGA)
+    vgacon_write(&s, 1);
+  if (console_sinks & CONSOLE_UART)
+    uart_putc(s);
+}
+
+void print(const char *s)
 {  
-  while (*s != '\0') {    
-      printc(*s);
-      s++;
+  const char *e = s;
+  while (*e != '\0')
+    e++;
+  console_write(s, e - s);
+}
+
+/*
+ * Number formatting. Every fmt_* function writes a NUL-terminated string
+ * into buf and returns its length, so callers can hand the result to
+ * console_write in one burst. Division by constants is done with explicit
+ * reciprocal multiplies (mulhu) so no div instruction is emitted even at
+ * -Os, and decimal digits are produced two at a time from fmt_digits2.
+ */
+static const char fmt_digits2[200] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+static const char fmt_hexdigits[16] = "0123456789ABCDEF";
+static const unsigned fmt_pow10[9] = {
+  10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/* Exact for every 32-bit x. */
+static inline unsigned div100(unsigned x)
+{
+  return (unsigned) (((unsigned long long) x * 0x51EB851Fu) >> 37);
+}
+
+/* Exact for every 32-bit x. */
+static inline unsigned div10000(unsigned x)
+{
+  return (unsigned) (((unsigned long long) x * 0xD1B71759u) >> 45);
+}
+
+static inline unsigned fmt_len_u32(unsigned x)
+{
+  unsigned len = 1;
+  while (len < 10 && x >= fmt_pow10[len - 1])
+    len++;
+  return len;
+}
+
+/* Write the decimal digits of x backwards, ending just before end. */
+static char *fmt_put_u32(char *end, unsigned x)
+{
+  while (x >= 100) {
+    unsigned q = div100(x);
+    unsigned r = 2 * (x - q * 100);
+    end -= 2;
+    end[0] = fmt_digits2[r];
+    end[1] = fmt_digits2[r + 1];
+    x = q;
+  }
+  if (x >= 10) {
+    end -= 2;
+    end[0] = fmt_digits2[2 * x];
+    end[1] = fmt_digits2[2 * x + 1];
+  } else {
+    *--end = '0' + x;
+  }
+  return end;
+}
+
+/* Write exactly four digits of x (< 10000) starting at p. */
+static inline void fmt_put4(char *p, unsigned x)
+{
+  unsigned hi = div100(x);
+  unsigned lo = 2 * (x - hi * 100);
+  hi *= 2;
+  p[0] = fmt_digits2[hi];
+  p[1] = fmt_digits2[hi + 1];
+  p[2] = fmt_digits2[lo];
+  p[3] = fmt_digits2[lo + 1];
+}
+
+/* n /= 10000 using four 16-bit limbs, so only 32-bit reciprocals are
+   needed; returns the remainder. */
+static unsigned fmt_divmod10000(unsigned long long *n)
+{
+  unsigned hi = (unsigned) (*n >> 32), lo = (unsigned) *n;
+  unsigned q3, q2, q1, q0, t;
+
+  t = hi >> 16;
+  q3 = div10000(t);
+  t = ((t - q3 * 10000) << 16) | (hi & 0xffff);
+  q2 = div10000(t);
+  t = ((t - q2 * 10000) << 16) | (lo >> 16);
+  q1 = div10000(t);
+  t = ((t - q1 * 10000) << 16) | (lo & 0xffff);
+  q0 = div10000(t);
+  *n = ((unsigned long long) ((q3 << 16) | q2) << 32) | ((q1 << 16) | q0);
+  return t - q0 * 10000;
+}
+
+int fmt_u32(char *buf, unsigned x)
+{
+  unsigned len = fmt_len_u32(x);
+  fmt_put_u32(buf + len, x);
+  buf[len] = '\0';
+  return len;
+}
+
+int fmt_i32(char *buf, int x)
+{
+  if (x < 0) {
+    *buf = '-';
+    return 1 + fmt_u32(buf + 1, 0u - (unsigned) x);
+  }
+  return fmt_u32(buf, x);
+}
+
+int fmt_u64(char *buf, unsigned long long x)
+{
+  char tmp[FMT_U64_SIZE];
+  char *end = tmp + sizeof(tmp) - 1;
+  char *p = end;
+  int len;
+
+  if ((x >> 32) == 0)
+    return fmt_u32(buf, (unsigned) x);
+  while ((x >> 32) != 0) {
+    p -= 4;
+    fmt_put4(p, fmt_divmod10000(&x));
+  }
+  p = fmt_put_u32(p, (unsigned) x);
+  for (len = 0; p != end; len++)
+    buf[len] = *p++;
+  buf[len] = '\0';
+  return len;
+}
+
+int fmt_i64(char *buf, long long x)
+{
+  if (x < 0) {
+    *buf = '-';
+    return 1 + fmt_u64(buf + 1, 0ull - (unsigned long long) x);
+  }
+  return fmt_u64(buf, x);
+}
+
+/* Right-align the decimal value of x in a field of width characters,
+   filling on the left with pad (typically ' ' or '0'). */
+int fmt_u32_pad(char *buf, unsigned x, int width, char pad)
+{
+  int len = fmt_len_u32(x);
+  int fill = width > len ? width - len : 0;
+  for (int i = 0; i < fill; i++)
+    buf[i] = pad;
+  fmt_put_u32(buf + fill + len, x);
+  buf[fill + len] = '\0';
+  return fill + len;
+}
+
+/* Upper-case hex of x, zero-padded to digits (1-8); 0 prints only the
+   significant digits. */
+int fmt_hex32(char *buf, unsigned x, int digits)
+{
+  if (digits <= 0) {
+    digits = 1;
+    while (digits < 8 && (x >> (4 * digits)) != 0)
+      digits++;
   }
+  for (int i = digits - 1; i >= 0; i--) {
+    buf[i] = fmt_hexdigits[x & 0xf];
+    x >>= 4;
+  }
+  buf[digits] = '\0';
+  return digits;
+}
+
+int fmt_hex64(char *buf, unsigned long long x, int digits)
+{
+  unsigned hi = (unsigned) (x >> 32);
+  int len;
+
+  if (hi == 0 && digits <= 8)
+    return fmt_hex32(buf, (unsigned) x, digits);
+  len = fmt_hex32(buf, hi, digits > 8 ? digits - 8 : 0);
+  return len + fmt_hex32(buf + len, (unsigned) x, 8);
 }
 
 void print_dec(unsigned int x)
 {
-  unsigned divident = 1000000000;
-  char first = 0;
-  do {
-    int dv = x / divident;
-    if (dv != 0) first = 1;
-    if (first != 0)
-      printc(48+dv);
-    x -= dv*divident;
-    divident /= 10;
-  } while (divident != 0);
-    if (first == 0)
-	printc(48);
+  char buf[FMT_U32_SIZE];
+  console_write(buf, fmt_u32(buf, x));
 }
 
 void print_hex32 ( unsigned int x)
 {
-  printc('0');
-  printc('x');
-  for (int i = 7; i >= 0; i--) {
-    char hd = (char) ((x >> (i*4)) & 0xf);
-    if (hd < 10)
-      hd += '0';
-    else
-      hd += ('A' - 10);
-    printc(hd);
-  }   
+  char buf[2 + FMT_HEX32_SIZE];
+  buf[0] = '0';
+  buf[1] = 'x';
+  console_write(buf, 2 + fmt_hex32(buf + 2, x, 8));
+}
+
+/*
+ * System calls. An ecall with the call number in a7 and arguments in
+ * a0-a5 is dispatched through syscall_table; the handler's return value
+ * is handed back in a0 (boot.S writes it into the saved frame).
+ */
+static unsigned sys_print_int(unsigned a0, unsigned a1, unsigned a2,
+                              unsigned a3, unsigned a4, unsigned a5)
+{
+  char buf[FMT_I32_SIZE];
+  console_write(buf, fmt_i32(buf, (int) a0));
+  return 0;
+}
+
+static unsigned sys_print_string(unsigned a0, unsigned a1, unsigned a2,
+                                 unsigned a3, unsigned a4, unsigned a5)
+{
+  print((const char *) a0);
+  return 0;
+}
+
+static unsigned sys_print_char(unsigned a0, unsigned a1, unsigned a2,
+                               unsigned a3, unsigned a4, unsigned a5)
+{
+  printc(a0);
+  return 0;
+}
+
+static unsigned sys_print_hex(unsigned a0, unsigned a1, unsigned a2,
+                              unsigned a3, unsigned a4, unsigned a5)
+{
+  print_hex32(a0);
+  return 0;
+}
+
+/* write(fd, buf, len): fd is accepted for RARS compatibility and ignored. */
+static unsigned sys_write(unsigned a0, unsigned a1, unsigned a2,
+                          unsigned a3, unsigned a4, unsigned a5)
+{
+  console_write((const char *) a1, a2);
+  return a2;
+}
+
+static unsigned sys_puts(unsigned a0, unsigned a1, unsigned a2,
+                         unsigned a3, unsigned a4, unsigned a5)
+{
+  print((const char *) a0);
+  printc('\n');
+  return 0;
+}
+
+static unsigned sys_cycles(unsigned a0, unsigned a1, unsigned a2,
+                           unsigned a3, unsigned a4, unsigned a5)
+{
+  unsigned c;
+  asm volatile ("csrr %0, mcycle" : "=r"(c));
+  return c;
+}
+
+/* Nothing else to run until a scheduler registers its own yield. */
+static unsigned sys_yield(unsigned a0, unsigned a1, unsigned a2,
+                          unsigned a3, unsigned a4, unsigned a5)
+{
+  return 0;
+}
+
+static syscall_fn syscall_table[SYSCALL_MAX] = {
+  [SYS_PRINT_INT]    = sys_print_int,
+  [SYS_PRINT_STRING] = sys_print_string,
+  [SYS_PRINT_CHAR]   = sys_print_char,
+  [SYS_PRINT_HEX]    = sys_print_hex,
+  [SYS_WRITE]        = sys_write,
+  [SYS_PUTS]         = sys_puts,
+  [SYS_CYCLES]       = sys_cycles,
+  [SYS_YIELD]        = sys_yield,
+};
+
+/* function: syscall_register
+   Description: Install fn as the handler for ecall number num (or
+   remove it with fn = 0). Returns the previous handler, or 0 if num is
+   out of range. */
+syscall_fn syscall_register(unsigned num, syscall_fn fn)
+{
+  syscall_fn old;
+  if (num >= SYSCALL_MAX)
+    return 0;
+  old = syscall_table[num];
+  syscall_table[num] = fn;
+  return old;
 }
 
 /* function: handle_exception
-   Description: This code handles an exception. */
-void handle_exception ( unsigned arg0, unsigned arg1, unsigned arg2, unsigned arg3, unsigned arg4, unsigned arg5, unsigned mcause, unsigned syscall_num )
+   Description: This code handles an exception. For an ecall the
+   return value is passed back to the caller in a0. For any other
+   exception arg0 is mepc and arg1 the saved register frame. Illegal
+   instructions and misaligned accesses only get here once
+   trap_emulate (called first from _isr_routine) has turned them down. */
+unsigned handle_exception ( unsigned arg0, unsigned arg1, unsigned arg2, unsigned arg3, unsigned arg4, unsigned arg5, unsigned mcause, unsigned syscall_num )
 {
   switch (mcause)
     {
@@ -59,13 +538,15 @@ void handle_exception ( unsigned arg0, unsigned arg1, unsigned arg2, unsigned ar
     case 2:
       print("\n[EXCEPTION] Illegal instruction. "); 
       break;
-    case 11:
-      if (syscall_num == 4)
-	print((char*) arg0); 
-      if (syscall_num == 11)
-	printc(arg0);
-      return ;
+    case 4:
+    case 6:
+      print(mcause == 4 ? "\n[EXCEPTION] Misaligned load. "
+                        : "\n[EXCEPTION] Misaligned store. ");
       break;
+    case 11:
+      if (syscall_num < SYSCALL_MAX && syscall_table[syscall_num])
+	return syscall_table[syscall_num](arg0, arg1, arg2, arg3, arg4, arg5);
+      return (unsigned) -1;
     default:
       print("\n[EXCEPTION] Unknown error. ");
       break;
@@ -76,51 +557,145 @@ void handle_exception ( unsigned arg0, unsigned arg1, unsigned arg2, unsigned ar
   while (1);
 }
 
+/*
+ * Primality engine behind nextprime.
+ *
+ * Candidates are stepped over a 2*3*5 wheel, so only the 8 residues
+ * mod 30 that are coprime to 30 are ever tested. Below
+ * PRIME_TRIAL_LIMIT a candidate is trial-divided by wheel numbers up to
+ * its square root. Above it, a short trial pass rejects most composites
+ * and a deterministic Miller-Rabin test with bases 2, 7 and 61 (exact
+ * for every n < 4759123141) decides the rest. Modular multiplication
+ * uses Montgomery reduction, so it only needs mul/mulhu from the M
+ * extension and never a 64-bit division.
+ */
+#ifndef PRIME_TRIAL_LIMIT
+#define PRIME_TRIAL_LIMIT 0x10000
+#endif
+#define PRIME_PREFILTER   64   /* Trial-divide by wheel numbers below this first */
+
+static const unsigned char prime_residues[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+static const unsigned char prime_gaps[8]     = { 6, 4, 2, 4, 2, 4, 6, 2 };
+
+/* Gaps between wheel numbers starting from 7: 7, 11, 13, 17, 19, 23, 29, 31, 37, ... */
+static const unsigned char prime_wheel[8] = { 4, 2, 4, 2, 4, 6, 2, 6 };
+
+/* Returns 0 if a wheel number in [7, limit] divides n. */
+static int prime_trial(unsigned n, unsigned limit)
+{
+  unsigned f = 7;
+  int i = 0;
+  while (f <= limit && f * f <= n) {
+    if (n % f == 0)
+      return 0;
+    f += prime_wheel[i];
+    i = (i + 1) & 7;
+  }
+  return 1;
+}
+
+/* Montgomery multiplication a*b/2^32 mod n for odd n, a, b < n. */
+static inline unsigned mont_mul(unsigned a, unsigned b, unsigned n, unsigned ninv)
+{
+  unsigned long long t = (unsigned long long) a * b;
+  unsigned lo = (unsigned) t;
+  unsigned m = lo * ninv;
+  unsigned long long r = (t >> 32) + (((unsigned long long) m * n) >> 32) + (lo != 0);
+  return r >= n ? (unsigned) (r - n) : (unsigned) r;
+}
+
+/* One Miller-Rabin round for odd n with n - 1 = d * 2^s. */
+static int prime_mr_round(unsigned n, unsigned ninv, unsigned r1, unsigned r2,
+                          unsigned d, int s, unsigned a)
+{
+  unsigned minus_one = n - r1;
+  unsigned base = mont_mul(a, r2, n, ninv);  /* a in Montgomery form */
+  unsigned x = base;
+  unsigned bit = 1u << 31;
+
+  while ((d & bit) == 0)
+    bit >>= 1;
+  for (bit >>= 1; bit != 0; bit >>= 1) {
+    x = mont_mul(x, x, n, ninv);
+    if (d & bit)
+      x = mont_mul(x, base, n, ninv);
+  }
+  if (x == r1 || x == minus_one)
+    return 1;
+  while (--s > 0) {
+    x = mont_mul(x, x, n, ninv);
+    if (x == minus_one)
+      return 1;
+  }
+  return 0;
+}
+
+/* Deterministic Miller-Rabin for odd n > 61. */
+static int prime_mr(unsigned n)
+{
+  unsigned ninv = n, r1, r2, d;
+  int s = 0;
+
+  for (int i = 0; i < 4; i++)  /* Newton: 3 -> 48 correct bits of 1/n */
+    ninv *= 2 - n * ninv;
+  ninv = 0u - ninv;
+
+  r1 = (0u - n) % n;           /* 2^32 mod n, Montgomery 1 */
+  r2 = r1;
+  for (int i = 0; i < 32; i++) /* 2^64 mod n by doubling */
+    r2 = r2 >= n - r2 ? r2 - (n - r2) : r2 + r2;
+
+  for (d = n - 1; (d & 1) == 0; d >>= 1)
+    s++;
+
+  return prime_mr_round(n, ninv, r1, r2, d, s, 2)
+      && prime_mr_round(n, ninv, r1, r2, d, s, 7)
+      && prime_mr_round(n, ninv, r1, r2, d, s, 61);
+}
+
+/* Primality of a wheel candidate (n >= 7, coprime to 30). */
+static int prime_test(unsigned n)
+{
+  if (n < PRIME_TRIAL_LIMIT)
+    return prime_trial(n, n);
+  return prime_trial(n, PRIME_PREFILTER) && prime_mr(n);
+}
+
 /*
  * nextprime
  * 
  * Return the first prime number larger than the integer
  * given as a parameter. The integer must be positive.
  */
-#define PRIME_FALSE   0     /* Constant to help readability. */
-#define PRIME_TRUE    1     /* Constant to help readability. */
 int nextprime( int inval )
 {
-   register int perhapsprime = 0; /* Holds a tentative prime while we check it. */
-   register int testfactor; /* Holds various factors for which we test perhapsprime. */
-   register int found;      /* Flag, false until we find a prime. */
-
-   if (inval < 3 )          /* Initial sanity check of parameter. */
-   {
-     if(inval <= 0) return(1);  /* Return 1 for zero or negative input. */
-     if(inval == 1) return(2);  /* Easy special case. */
-     if(inval == 2) return(3);  /* Easy special case. */
-   }
-   else
-   {
-     /* Testing an even number for primeness is pointless, since
-      * all even numbers are divisible by 2. Therefore, we make sure
-      * that perhapsprime is larger than the parameter, and odd. */
-     perhapsprime = ( inval + 1 ) | 1 ;
-   }
-   /* While prime not found, loop. */
-   for( found = PRIME_FALSE; found != PRIME_TRUE; perhapsprime += 2 )
-   {
-     /* Check factors from 3 up to perhapsprime/2. */
-     for( testfactor = 3; testfactor <= (perhapsprime >> 1) + 1; testfactor += 1 )
-     {
-       found = PRIME_TRUE;      /* Assume we will find a prime. */
-       if( (perhapsprime % testfactor) == 0 ) /* If testfactor divides perhapsprime... */
-       {
-         found = PRIME_FALSE;   /* ...then, perhapsprime was non-prime. */
-         goto check_next_prime; /* Break the inner loop, go test a new perhapsprime. */
-       }
-     }
-     check_next_prime:;         /* This label is used to break the inner loop. */
-     if( found == PRIME_TRUE )  /* If the loop ended normally, we found a prime. */
-     {
-       return( perhapsprime );  /* Return the prime we found. */
-     } 
-   }
-   return( perhapsprime );      /* When the loop ends, perhapsprime is a real prime. */
-} 
+  unsigned candidate, r;
+  int i;
+
+  if (inval < 7)             /* Below the wheel's first prime. */
+  {
+    if (inval <= 0) return(1);  /* Return 1 for zero or negative input. */
+    if (inval == 1) return(2);
+    if (inval == 2) return(3);
+    if (inval <= 4) return(5);
+    return(7);
+  }
+
+  /* Align the first candidate to the next wheel residue. */
+  candidate = (unsigned) inval + 1;
+  r = candidate % 30;
+  for (i = 0; i < 8 && prime_residues[i] < r; i++)
+    ;
+  if (i == 8) {
+    candidate += 30 - r + prime_residues[0];
+    i = 0;
+  } else {
+    candidate += prime_residues[i] - r;
+  }
+
+  while (!prime_test(candidate)) {
+    candidate += prime_gaps[i];
+    i = (i + 1) & 7;
+  }
+  return( candidate );
+}
@@ -1,10 +1,678 @@
+#ifndef DTEKV_LIB_H
+#define DTEKV_LIB_H
+
+/* Mask interrupts (mstatus.MIE) and return the previous mstatus. */
+static inline unsigned irq_save(void)
+{
+  unsigned mstatus;
+  asm volatile ("csrrci %0, mstatus, 8" : "=r"(mstatus) :: "memory");
+  return mstatus;
+}
+
+/* Re-enable interrupts if they were enabled when irq_save was called. */
+static inline void irq_restore(unsigned mstatus)
+{
+  asm volatile ("csrs mstatus, %0" :: "r"(mstatus & 8) : "memory");
+}
+
+/* Index of the lowest set bit of a non-zero word (de Bruijn multiply;
+   rv32im has no ctz instruction and there is no libgcc). */
+static inline unsigned bit_lowest(unsigned x)
+{
+  static const unsigned char debruijn32[32] = {
+    0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+    31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+  };
+  return debruijn32[((x & (0u - x)) * 0x077CB531u) >> 27];
+}
+
+/* Transmit policies for the buffered JTAG UART path (see uart_tx_init). */
+#define UART_TX_UNBUFFERED 0  /* Busy-wait on the FIFO for every character */
+#define UART_TX_BLOCK      1  /* Buffer; wait for room when the ring is full */
+#define UART_TX_DROP       2  /* Buffer; discard new output when full */
+#define UART_TX_OVERWRITE  3  /* Buffer; discard the oldest output when full */
+
+#ifndef UART_TX_BUFFER_SIZE
+#define UART_TX_BUFFER_SIZE 1024  /* Must be a power of two */
+#endif
+
+#ifndef UART_RX_BUFFER_SIZE
+#define UART_RX_BUFFER_SIZE 256   /* Must be a power of two */
+#endif
+
+/* The memory map does not list an IRQ for the JTAG UART; override this
+   to match the board's design if it differs. */
+#ifndef JTAG_UART_IRQ
+#define JTAG_UART_IRQ 19
+#endif
+
+/* Buffer sizes, including the terminating NUL, for the fmt_* functions. */
+#define FMT_U32_SIZE   11
+#define FMT_I32_SIZE   12
+#define FMT_U64_SIZE   21
+#define FMT_I64_SIZE   21
+#define FMT_HEX32_SIZE 9
+#define FMT_HEX64_SIZE 17
+
+/* Strikes spent sieving the next segment on each prime_stream_next call. */
+#ifndef PRIME_STREAM_STEP
+#define PRIME_STREAM_STEP 64
+#endif
+
+/* Consecutive-prime generator state (see dtekv-sieve.c). */
+struct prime_stream {
+  unsigned *front, *back;   /* Segment bitmaps over odd numbers, 1 = composite */
+  unsigned words;           /* Words per segment */
+  unsigned front_base;      /* Odd number held by bit 0 of front */
+  unsigned back_base;       /* Odd number held by bit 0 of back */
+  unsigned pos;             /* Next bit of front to examine */
+  unsigned *sieving;        /* Odd sieving primes, ascending */
+  unsigned *offset;         /* Next multiple of each, as a bit index into back */
+  unsigned nsieving, maxsieving;
+  unsigned back_done;       /* Sieving primes fully struck from back */
+  char emit_two, last_segment, exhausted;
+};
+
+/*
+ * Profiling probes. Wrap a region in PROF_BEGIN(id) ... PROF_END(id),
+ * where id is a constant below PROF_MAX_PROBES (an enum works well).
+ * The timestamps are two csrr reads on each side; the bookkeeping in
+ * prof_record runs after the end timestamp so it is not counted. It is
+ * inline and short: a count, two 32-bit adds and min/max. The 64-bit
+ * totals are folded in when the profile is read, and the log2 histogram
+ * is only kept with PROF_HIST 1 (make PROF=1 PROF_HIST=1). With
+ * PROF_ENABLE 0 every macro and function below compiles to nothing.
+ */
+#ifndef PROF_ENABLE
+#define PROF_ENABLE 0
+#endif
+#ifndef PROF_HIST
+#define PROF_HIST 0
+#endif
+#define PROF_MAX_PROBES 16
+#define PROF_NAME_LEN   16
+
+/* PC samples taken by PROF_SAMPLE in interrupt handlers, counted in
+   buckets of 2^PROF_PC_SHIFT bytes from address 0; hot-layout.py turns
+   them into the .text order in dtekv-hot.ld (make layout). */
+#define PROF_PC_SHIFT   4
+#define PROF_PC_BUCKETS 2048      /* Covers the first 32 KB of .text */
+
+#if PROF_ENABLE
+struct prof_probe {
+  const char *name;
+  unsigned count;
+  unsigned min_cycles, max_cycles;
+  unsigned cycles, instret; /* Added by every PROF_END, not yet in the totals */
+  unsigned long long total_cycles;
+  unsigned long long total_instret;
+  unsigned hist[32];        /* PROF_HIST: runs taking [2^b, 2^(b+1)) cycles */
+};
+
+/* Layout read back with dtekv-download after prof_export. */
+struct prof_export {
+  unsigned magic;           /* 0x464f5250, "PROF" */
+  unsigned probes;
+  char names[PROF_MAX_PROBES][PROF_NAME_LEN];
+  struct prof_probe data[PROF_MAX_PROBES];
+};
+
+static inline unsigned prof_rdcycle(void)
+{
+  unsigned c;
+  asm volatile ("csrr %0, mcycle" : "=r"(c));
+  return c;
+}
+
+static inline unsigned prof_rdinstret(void)
+{
+  unsigned c;
+  asm volatile ("csrr %0, minstret" : "=r"(c));
+  return c;
+}
+
+extern struct prof_probe prof_table[PROF_MAX_PROBES];
+
+void prof_fold(struct prof_probe *p);
+void prof_hist(struct prof_probe *p, unsigned cycles);
+
+/* Called by PROF_END. The 32-bit sums are folded early once the cycle
+   sum passes 2^31; the instret sum never outgrows it. */
+static inline void prof_record(unsigned id, unsigned cycles, unsigned instret)
+{
+  struct prof_probe *p = &prof_table[id];
+
+  if (p->count == 0 || cycles < p->min_cycles)
+    p->min_cycles = cycles;
+  if (cycles > p->max_cycles)
+    p->max_cycles = cycles;
+  p->count++;
+  p->cycles += cycles;
+  p->instret += instret;
+  if ((int) p->cycles < 0)
+    prof_fold(p);
+  if (PROF_HIST)
+    prof_hist(p, cycles);
+}
+
+void prof_sample(unsigned pc);
+void prof_name(unsigned id, const char *name);
+void prof_reset(void);
+void prof_dump(void);
+struct prof_export *prof_export(void);
+
+#define PROF_BEGIN(id) \
+  unsigned prof_cycle_##id = prof_rdcycle(), prof_instret_##id = prof_rdinstret()
+#define PROF_END(id) \
+  do { \
+    unsigned prof_c = prof_rdcycle(), prof_i = prof_rdinstret(); \
+    prof_record((id), prof_c - prof_cycle_##id, prof_i - prof_instret_##id); \
+  } while (0)
+
+/* Record where the interrupted code was; call from an interrupt handler. */
+#define PROF_SAMPLE() \
+  do { \
+    unsigned prof_pc; \
+    asm volatile ("csrr %0, mepc" : "=r"(prof_pc)); \
+    prof_sample(prof_pc); \
+  } while (0)
+#else
+#define PROF_BEGIN(id)        do { } while (0)
+#define PROF_END(id)          do { } while (0)
+#define PROF_SAMPLE()         do { } while (0)
+#define prof_name(id, name)   ((void) 0)
+#define prof_reset()          ((void) 0)
+#define prof_dump()           ((void) 0)
+#define prof_export()         ((struct prof_export *) 0)
+#endif
+
+/* ecall numbers (in a7). 1-64 follow RARS; the rest are DTEK-V extensions. */
+#define SYS_PRINT_INT     1   /* a0 = signed value */
+#define SYS_PRINT_STRING  4   /* a0 = string */
+#define SYS_PRINT_CHAR   11   /* a0 = character */
+#define SYS_PRINT_HEX    34   /* a0 = value */
+#define SYS_WRITE        64   /* a0 = fd (ignored), a1 = buffer, a2 = length */
+#define SYS_PUTS        100   /* a0 = string, printed with a trailing newline */
+#define SYS_CYCLES      101   /* returns mcycle */
+#define SYS_YIELD       102   /* give up the CPU to another task, if any */
+#define SYSCALL_MAX     128
+
+typedef unsigned (*syscall_fn)(unsigned a0, unsigned a1, unsigned a2,
+                               unsigned a3, unsigned a4, unsigned a5);
+
+/* Issue ecall num with up to three arguments; returns a0. */
+static inline unsigned syscall3(unsigned num, unsigned a0, unsigned a1, unsigned a2)
+{
+  register unsigned r0 asm("a0") = a0;
+  register unsigned r1 asm("a1") = a1;
+  register unsigned r2 asm("a2") = a2;
+  register unsigned r7 asm("a7") = num;
+  asm volatile ("ecall" : "+r"(r0) : "r"(r1), "r"(r2), "r"(r7) : "memory");
+  return r0;
+}
+
+static inline unsigned sys_write_buf(const char *buf, unsigned len)
+{
+  return syscall3(SYS_WRITE, 1, (unsigned) buf, len);
+}
+
+static inline unsigned sys_read_cycles(void)
+{
+  return syscall3(SYS_CYCLES, 0, 0, 0);
+}
+
+static inline void sys_yield_cpu(void)
+{
+  syscall3(SYS_YIELD, 0, 0, 0);
+}
+
+/* Deferred work: ISRs queue a function and argument, the main loop runs
+   them with interrupts enabled (see dtekv-work.c). */
+#ifndef WORK_QUEUE_SIZE
+#define WORK_QUEUE_SIZE 16   /* Must be a power of two */
+#endif
+
+typedef void (*work_fn)(unsigned arg);
+
+/* Debounce modes. */
+#define DEBOUNCE_PRESS  0   /* Act on a press, re-arm once released and stable */
+#define DEBOUNCE_CHANGE 1   /* Act on any change, re-arm once stable */
+
+/* Timer-driven debouncer for one Avalon PIO input block. */
+struct debouncer {
+  volatile int *pio;        /* PIO base: data, direction, IRQ mask, edge capture */
+  unsigned mask;            /* Input bits handled */
+  unsigned settle_ticks;    /* Ticks the input must be stable before re-arming */
+  int mode;                 /* DEBOUNCE_PRESS or DEBOUNCE_CHANGE */
+  work_fn action;           /* Queued on each accepted edge, unless 0 */
+  unsigned arg;
+  unsigned level;           /* Last sampled input bits */
+  unsigned count;           /* Stable ticks left; 0 when armed */
+};
+
+/* Lock-free single-producer, single-consumer ring. RING_DECLARE(name,
+   type, size) defines struct name with name_put, name_get and
+   name_get_batch; size must be a power of two. The producer only writes
+   head and the consumer only writes tail, so neither side masks
+   interrupts. Handlers never nest, so all of them together count as one
+   producer. With one in-order hart a compiler barrier is enough: the
+   slot is written before head publishes it and read before tail hands
+   it back. */
+#define RING_BARRIER() asm volatile ("" ::: "memory")
+
+#define RING_DECLARE(name, type, size)                                    \
+struct name {                                                             \
+  volatile unsigned head;   /* Next slot to fill, producer only */        \
+  volatile unsigned tail;   /* Next slot to read, consumer only */        \
+  unsigned lost;            /* Puts refused because the ring was full */  \
+  type slot[size];                                                        \
+};                                                                        \
+typedef char name##_size_check[((size) & ((size) - 1)) == 0 ? 1 : -1];    \
+static inline int name##_put(struct name *r, const type *item)            \
+{                                                                         \
+  unsigned head = r->head;                                                \
+  if (head - r->tail >= (size)) {                                         \
+    r->lost++;                                                            \
+    return -1;                                                            \
+  }                                                                       \
+  r->slot[head & ((size) - 1)] = *item;                                   \
+  RING_BARRIER();                                                         \
+  r->head = head + 1;                                                     \
+  return 0;                                                               \
+}                                                                         \
+static inline int name##_get(struct name *r, type *item)                  \
+{                                                                         \
+  unsigned tail = r->tail;                                                \
+  if (tail == r->head)                                                    \
+    return 0;                                                             \
+  RING_BARRIER();                                                         \
+  *item = r->slot[tail & ((size) - 1)];                                   \
+  RING_BARRIER();                                                         \
+  r->tail = tail + 1;                                                     \
+  return 1;                                                               \
+}                                                                         \
+static inline unsigned name##_get_batch(struct name *r, type *items,      \
+                                        unsigned max)                     \
+{                                                                         \
+  unsigned tail = r->tail, n = r->head - tail;                            \
+  if (n > max)                                                            \
+    n = max;                                                              \
+  RING_BARRIER();                                                         \
+  for (unsigned i = 0; i < n; i++)                                        \
+    items[i] = r->slot[(tail + i) & ((size) - 1)];                        \
+  RING_BARRIER();                                                         \
+  r->tail = tail + n;                                                     \
+  return n;                                                               \
+}
+
+/* Timestamped events from the interrupt handlers to the main loop
+   (see dtekv-work.c). */
+#ifndef EVENT_RING_SIZE
+#define EVENT_RING_SIZE 64   /* Must be a power of two */
+#endif
+
+#define EV_TICK   1          /* Periodic timer; data is the tick count */
+#define EV_BUTTON 2          /* Debounced button; data is the level */
+#define EV_SWITCH 3          /* Debounced switch; data is the level */
+
+struct event {
+  unsigned cycle;            /* mcycle when it was posted */
+  unsigned type;
+  unsigned data;
+};
+
+/* Software timers on the Avalon timer (see dtekv-timer.c). */
+#ifndef TIMER_WHEEL_SLOTS
+#define TIMER_WHEEL_SLOTS 256   /* Power of two, multiple of 32 */
+#endif
+
+struct soft_timer {
+  struct soft_timer *next, *prev;
+  struct soft_timer *fired_next;  /* timer_isr's list of timers due now */
+  unsigned expiry;          /* Tick at which it fires */
+  unsigned period;          /* Re-armed every period ticks; 0 = one-shot */
+  work_fn fn;
+  unsigned arg;
+  unsigned state;
+};
+
+/* Lateness and missed periods of a timer interrupt, cheap enough to
+   leave on in every build (see dtekv-timer.c). */
+#ifndef TIMER_LATE_CYCLES
+#define TIMER_LATE_CYCLES 3000    /* 100 us at 30 MHz */
+#endif
+
+struct timer_health {
+  unsigned period;          /* Cycles per period */
+  unsigned late_cycles;     /* Latency above this counts in late */
+  unsigned last_timeout;    /* mcycle at the last timeout handled */
+  unsigned irqs;            /* Interrupts handled */
+  unsigned late;            /* Handled more than late_cycles after the timeout */
+  unsigned missed;          /* Periods that ended without an interrupt of their own */
+  unsigned max_latency;     /* Most cycles from timeout to handler */
+};
+
+/* Delays on the cycle counter (see dtekv-delay.c). */
+#ifndef DELAY_CLOCK_HZ
+#define DELAY_CLOCK_HZ 30000000   /* Core clock labinit assumes */
+#endif
+#define DELAY_CYCLES_PER_US (DELAY_CLOCK_HZ / 1000000)
+#ifndef DELAY_SPIN_CYCLES
+#define DELAY_SPIN_CYCLES 3000    /* Waits shorter than this never wfi */
+#endif
+
+/* Low word of mcycle; wraps after about 143 s at 30 MHz. */
+static inline unsigned mcycle_now(void)
+{
+  unsigned c;
+  asm volatile ("csrr %0, mcycle" : "=r"(c));
+  return c;
+}
+
+/* Time of day kept as binary seconds (see dtekv-clock.c). */
+#define CLOCK_DAY_SECONDS 86400
+
+struct clock {
+  unsigned seconds;         /* 0 .. CLOCK_DAY_SECONDS - 1 */
+  unsigned bcd_seconds;     /* Value bcd was last converted from */
+  unsigned bcd;             /* 0xHHMMSS for bcd_seconds */
+};
+
+/* Six 7-segment displays (see dtekv-display.c). Position 0 is the
+   rightmost digit. */
+#define DISPLAY_DIGITS 6
+
+struct display_scroll {
+  const char *text;
+  unsigned len;
+  unsigned offset;          /* Window start in blanks + text */
+};
+
+/* VGA, 320x240 at one byte per pixel (see dtekv-vga.c). */
+#define VGA_WIDTH  320
+#define VGA_HEIGHT 240
+#define VGA_FRAME_BYTES (VGA_WIDTH * VGA_HEIGHT)
+
+/* 8-bit colour, 3 bits red, 3 bits green, 2 bits blue. */
+#define VGA_RGB(r, g, b) ((((r) & 0xE0) | (((g) & 0xE0) >> 3) | (((b) & 0xC0) >> 6)) & 0xFF)
+
+/* Text console on the VGA output (see dtekv-console.c). */
+#define VGACON_COLS 40
+#define VGACON_ROWS 30
+
+/* Output sinks for printc/print and the print ecalls (console_sink). */
+#define CONSOLE_UART 1
+#define CONSOLE_VGA  2
+#define CONSOLE_BOTH (CONSOLE_UART | CONSOLE_VGA)
+
+/* Arena and pool allocators on the linker script's heap region
+   (see dtekv-alloc.c). */
+#define ALLOC_ALIGN 8
+#define HEAP_CLASSES 5          /* Block sizes 16, 32, 64, 128, 256 */
+#define HEAP_MIN_BLOCK 16
+
+struct arena {
+  char *base, *next, *end;
+  unsigned high;            /* Most bytes ever in use */
+};
+
+struct pool {
+  void *free;               /* Free list, linked through the blocks */
+  char *start, *end;        /* Block storage, for ownership checks */
+  unsigned size, count;     /* Block size and number of blocks */
+  unsigned used, high;      /* Blocks in use now and at most */
+  unsigned fails;           /* Allocations refused: pool empty */
+  unsigned requested;       /* Bytes asked for, summed over all allocations */
+  unsigned allocs;          /* Allocations served */
+};
+
+/* Fixed point (see dtekv-fixed.c). q16 is Q16.16 and q31 is Q1.31;
+   every operation saturates instead of wrapping. */
+typedef int q16;
+typedef int q31;
+
+#define Q16_ONE 0x10000
+#define Q16_MAX 0x7FFFFFFF
+#define Q16_MIN ((int) 0x80000000)
+#define Q31_MAX 0x7FFFFFFF
+#define Q31_MIN ((int) 0x80000000)
+#define Q16_PI  205887                  /* pi, rounded */
+
+/* Constant conversions, folded by the compiler: Q16(1.5), Q31(0.25). */
+#define Q16(x) ((q16) ((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define Q31(x) ((q31) ((x) * 2147483648.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define Q16_FROM_INT(n) ((q16) ((n) << 16))
+#define Q16_TO_INT(x)   ((x) >> 16)     /* Rounds towards minus infinity */
+
+/* a + b, saturating. */
+static inline int q16_add(int a, int b)
+{
+  int s = (int) ((unsigned) a + (unsigned) b);
+  if (((a ^ s) & (b ^ s)) < 0)
+    s = a < 0 ? Q16_MIN : Q16_MAX;
+  return s;
+}
+
+/* a - b, saturating. */
+static inline int q16_sub(int a, int b)
+{
+  int s = (int) ((unsigned) a - (unsigned) b);
+  if (((a ^ b) & (a ^ s)) < 0)
+    s = a < 0 ? Q16_MIN : Q16_MAX;
+  return s;
+}
+
+#define q31_add q16_add
+#define q31_sub q16_sub
+
+/* a * b rounded, saturating. The 64-bit product is one mul and one
+   mulh; the result is its middle 32 bits. */
+static inline q16 q16_mul(q16 a, q16 b)
+{
+  long long p = (long long) a * b + 0x8000;
+  int hi = p >> 32;
+
+  if ((unsigned) ((hi >> 15) + 1) > 1)  /* hi outside [-2^15, 2^15) */
+    return hi < 0 ? Q16_MIN : Q16_MAX;
+  return (int) (p >> 16);
+}
+
+/* a * b rounded; only -1 * -1 saturates. */
+static inline q31 q31_mul(q31 a, q31 b)
+{
+  if (a == Q31_MIN && b == Q31_MIN)
+    return Q31_MAX;
+  return (int) (((long long) a * b + 0x40000000) >> 31);
+}
+
+/* Operations emulated in the trap path (see dtekv-emulate.c). The M
+   extension ones are numbered by their funct3. */
+#define EMU_MUL    0
+#define EMU_MULH   1
+#define EMU_MULHSU 2
+#define EMU_MULHU  3
+#define EMU_DIV    4
+#define EMU_DIVU   5
+#define EMU_REM    6
+#define EMU_REMU   7
+#define EMU_LOAD   8    /* Misaligned lb/lh/lw/lbu/lhu */
+#define EMU_STORE  9    /* Misaligned sh/sw */
+#define EMU_OPS    10
+
+struct emu_stat {
+  unsigned count;           /* Times emulated */
+  unsigned cycles;          /* Spent decoding and computing them */
+};
+
+/* Line-oriented command shell on the JTAG UART (see dtekv-shell.c). */
+#ifndef SHELL_MAX_VARS
+#define SHELL_MAX_VARS 16
+#endif
+#ifndef SHELL_MAX_CMDS
+#define SHELL_MAX_CMDS 16
+#endif
+#define SHELL_LINE_SIZE 80     /* Longest line, including the NUL */
+#define SHELL_MAX_ARGS  8
+
+/* A command gets the words of its line, argv[0] being its name. Return
+   0, or -1 to have the shell print the usage line. */
+typedef int (*shell_fn)(int argc, char **argv);
+
+/* Lines from the host's dtekv-shell, written straight into RAM with the
+   loader's upload command: the text into line[head % SLOTS], then head
+   one up. head starts wherever the host likes; dtekv-tools/dtekv-shell.c
+   repeats this layout. */
+#define SHELL_MAILBOX_SLOTS 4  /* Power of two */
+struct shell_mailbox {
+  char line[SHELL_MAILBOX_SLOTS][SHELL_LINE_SIZE];
+  volatile unsigned head;   /* Lines written so far */
+};
+
+/* Cooperative tasks (see dtekv-task.c and switch.S). */
+#define TASK_READY    0
+#define TASK_RUNNING  1
+#define TASK_SLEEPING 2
+#define TASK_DEAD     3
+
+struct task {
+  unsigned sp;              /* Saved stack pointer; first, switch.S relies on it */
+  struct task *next;        /* Run queue link */
+  unsigned state;
+  const char *name;
+  unsigned *stack;          /* Lowest word of the stack, 0 for the boot stack */
+  unsigned stack_size;      /* In bytes */
+  struct soft_timer timer;  /* Wake-up for task_sleep */
+};
+
+/* Stack watermarks (see dtekv-stack.c). boot.S paints the boot stack
+   with the same value. */
+#define STACK_PAINT 0xDEADBEEFu
+
+void *memcpy(void *dst, const void *src, unsigned n);
+void *memmove(void *dst, const void *src, unsigned n);
+void *memset(void *dst, int c, unsigned n);
+int memcmp(const void *a, const void *b, unsigned n);
 void printc(char );
-void print(char *);
+void print(const char *);
 void print_dec(unsigned int);
 void print_hex32 ( unsigned int);
-void handle_exception ( unsigned arg0, unsigned arg1, unsigned arg2, unsigned arg3, unsigned arg4, unsigned arg5, unsigned mcause, unsigned syscall_num );
+void uart_tx_init(int policy);
+void uart_tx_isr(void);
+void uart_tx_flush(void);
+unsigned uart_tx_dropped(void);
+void uart_write(const char *buf, unsigned len);
+void uart_rx_init(void);
+void uart_rx_isr(void);
+int uart_getc(void);
+unsigned uart_rx_dropped(void);
+void console_sink(int sinks);
+void console_write(const char *buf, unsigned len);
+int fmt_u32(char *buf, unsigned x);
+int fmt_i32(char *buf, int x);
+int fmt_u64(char *buf, unsigned long long x);
+int fmt_i64(char *buf, long long x);
+int fmt_u32_pad(char *buf, unsigned x, int width, char pad);
+int fmt_hex32(char *buf, unsigned x, int digits);
+int fmt_hex64(char *buf, unsigned long long x, int digits);
+void prime_stream_init(struct prime_stream *ps, unsigned start, unsigned *work,
+                       unsigned work_words, unsigned segment_words);
+unsigned prime_stream_next(struct prime_stream *ps);
+int work_queue(work_fn fn, unsigned arg);
+unsigned work_run(void);
+unsigned work_overflows(void);
+int event_post(unsigned type, unsigned data);
+unsigned event_drain(struct event *batch, unsigned max);
+unsigned event_overflows(void);
+void debounce_init(struct debouncer *d, volatile int *pio, unsigned mask,
+                   unsigned settle_ticks, int mode, work_fn action, unsigned arg);
+int debounce_edge(struct debouncer *d);
+void debounce_tick(struct debouncer *d);
+void timer_service_init(unsigned cycles_per_tick);
+unsigned timer_now(void);
+void timer_start(struct soft_timer *t, unsigned delay, unsigned period,
+                 work_fn fn, unsigned arg);
+void timer_cancel(struct soft_timer *t);
+void timer_isr(void);
+unsigned timer_tick_cycles(void);
+struct timer_health *timer_service_health(void);
+void timer_health_init(struct timer_health *h, unsigned period, unsigned late_cycles);
+unsigned timer_health_tick(struct timer_health *h);
+void timer_health_dump(const char *name, const struct timer_health *h);
+void delay_cycles(unsigned cycles);
+void delay_us(unsigned us);
+void delay_ms(unsigned ms);
+void sleep_until(unsigned cycle);
+void clock_set_bcd(struct clock *c, unsigned hhmmss);
+void clock_add(struct clock *c, int seconds);
+unsigned clock_bcd(struct clock *c);
+void display_put(unsigned pos, unsigned segments);
+void display_char(unsigned pos, char c);
+void display_bcd(unsigned bcd);
+void display_hex(unsigned value);
+void display_text(const char *text);
+void display_scroll_init(struct display_scroll *s, const char *text);
+void display_scroll_step(struct display_scroll *s);
+void display_invalidate(void);
+unsigned display_writes(void);
+void vga_init(void);
+unsigned char *vga_back(void);
+void vga_swap(void);
+void vga_clear(unsigned color);
+void vga_pixel(int x, int y, unsigned color);
+void vga_fill_rect(int x, int y, int w, int h, unsigned color);
+void vga_line(int x0, int y0, int x1, int y1, unsigned color);
+void vga_blit(int x, int y, int w, int h, const unsigned char *src);
+void vga_blit_key(int x, int y, int w, int h, const unsigned char *src, unsigned key);
+void vgacon_init(unsigned fg, unsigned bg);
+void vgacon_write(const char *buf, unsigned len);
+void vgacon_flush(void);
+void arena_init(struct arena *a, void *mem, unsigned size);
+void *arena_alloc(struct arena *a, unsigned size);
+unsigned arena_mark(struct arena *a);
+void arena_reset(struct arena *a, unsigned mark);
+int pool_init(struct pool *p, struct arena *a, unsigned size, unsigned count);
+void *pool_alloc(struct pool *p);
+void pool_free(struct pool *p, void *block);
+int heap_init(unsigned blocks_per_class);
+struct arena *heap_arena(void);
+void *heap_alloc(unsigned size);
+void heap_free(void *block);
+void heap_dump(void);
+q16 q16_div(q16 a, q16 b);
+q16 q16_sqrt(q16 x);
+q31 q31_sqrt(q31 x);
+q31 q31_sin_turn(unsigned turn);
+q31 q31_cos_turn(unsigned turn);
+q16 q16_sin(q16 radians);
+q16 q16_cos(q16 radians);
+void shell_init(void);
+int shell_var(const char *name, int *value);
+int shell_var_range(const char *name, int *value, int min, int max);
+int shell_cmd(const char *name, shell_fn fn, const char *usage);
+int shell_exec(char *line);
+unsigned shell_poll(void);
+int shell_parse_int(const char *s, int *value);
+void task_init(void);
+int task_create(struct task *t, const char *name, void (*fn)(unsigned),
+                unsigned arg, unsigned stack_bytes);
+void task_yield(void);
+void task_sleep(unsigned ticks);
+void task_sleep_until(unsigned tick);
+void task_wake(struct task *t);
+void task_exit(void);
+struct task *task_current(void);
+void stack_paint(void *lo, void *hi);
+unsigned stack_peak(const void *lo, const void *hi);
+unsigned stack_main_peak(void);
+unsigned stack_main_size(void);
+unsigned task_stack_peak(const struct task *t);
+void task_stack_dump(const struct task *t);
+syscall_fn syscall_register(unsigned num, syscall_fn fn);
+int trap_emulate(unsigned insn, unsigned *regs);
+const struct emu_stat *trap_emulate_stats(void);
+void trap_emulate_reset(void);
+void trap_emulate_dump(void);
+unsigned handle_exception ( unsigned arg0, unsigned arg1, unsigned arg2, unsigned arg3, unsigned arg4, unsigned arg5, unsigned mcause, unsigned syscall_num );
 int nextprime( int inval );
 
-
-
-
+#endif
@@ -0,0 +1,168 @@
+/* dtekv-prof.c
+
+   Probe table behind the PROF_BEGIN/PROF_END macros in dtekv-lib.h.
+   Each probe accumulates how many times it ran and the total, minimum
+   and maximum of its mcycle and minstret deltas, and with PROF_HIST a
+   histogram of cycle counts by power of two. The per-probe part is
+   inline in dtekv-lib.h and keeps 32-bit sums; prof_fold moves them
+   into the 64-bit totals before anything reads those. prof_sample
+   keeps a histogram of interrupted PCs, the function-level profile
+   behind the .text layout (hot-layout.py). Nothing here is compiled
+   unless PROF_ENABLE is set (make PROF=1). */
+
+#include "dtekv-lib.h"
+
+#if PROF_ENABLE
+
+#define PROF_EXPORT_MAGIC 0x464f5250   /* "PROF" */
+
+struct prof_probe prof_table[PROF_MAX_PROBES];
+
+/* Read back with dtekv-download by make layout. */
+unsigned prof_pc_hist[PROF_PC_BUCKETS];
+
+/* Snapshot written by prof_export for dtekv-download. */
+struct prof_export prof_export_area;
+
+/* floor(log2(x)) for x > 0, in five compares. */
+static inline unsigned prof_log2(unsigned x)
+{
+  unsigned r = 0;
+  if (x >> 16) { x >>= 16; r += 16; }
+  if (x >> 8)  { x >>= 8;  r += 8; }
+  if (x >> 4)  { x >>= 4;  r += 4; }
+  if (x >> 2)  { x >>= 2;  r += 2; }
+  if (x >> 1)  { r += 1; }
+  return r;
+}
+
+/* function: prof_fold
+   Description: Add p's 32-bit sums to its 64-bit totals and clear
+   them. */
+void prof_fold(struct prof_probe *p)
+{
+  p->total_cycles += p->cycles;
+  p->total_instret += p->instret;
+  p->cycles = p->instret = 0;
+}
+
+/* function: prof_hist
+   Description: Count one run of cycles in p's log2 histogram
+   (PROF_HIST only). */
+void prof_hist(struct prof_probe *p, unsigned cycles)
+{
+  p->hist[cycles ? prof_log2(cycles) : 0]++;
+}
+
+/* function: prof_sample
+   Description: Count one sample at pc. PCs past the histogram are
+   dropped. */
+void prof_sample(unsigned pc)
+{
+  pc >>= PROF_PC_SHIFT;
+  if (pc < PROF_PC_BUCKETS)
+    prof_pc_hist[pc]++;
+}
+
+void prof_name(unsigned id, const char *name)
+{
+  prof_table[id].name = name;
+}
+
+void prof_reset(void)
+{
+  for (int i = 0; i < PROF_MAX_PROBES; i++) {
+    const char *name = prof_table[i].name;
+    memset(&prof_table[i], 0, sizeof(prof_table[i]));
+    prof_table[i].name = name;
+  }
+  memset(prof_pc_hist, 0, sizeof(prof_pc_hist));
+}
+
+/* n / d by shift and subtract; there is no libgcc for 64-bit division. */
+static unsigned long long prof_div(unsigned long long n, unsigned d)
+{
+  unsigned long long q = 0, r = 0;
+  for (int i = 63; i >= 0; i--) {
+    r = (r << 1) | ((n >> i) & 1);
+    if (r >= d) {
+      r -= d;
+      q |= 1ull << i;
+    }
+  }
+  return q;
+}
+
+static void prof_field(const char *label, unsigned long long value)
+{
+  char buf[FMT_U64_SIZE];
+  print(label);
+  console_write(buf, fmt_u64(buf, value));
+}
+
+/* function: prof_dump
+   Description: Print every probe that has run over the JTAG UART. */
+void prof_dump(void)
+{
+  char buf[FMT_U32_SIZE];
+
+  print("\n== profile (cycles) ==\n");
+  for (int i = 0; i < PROF_MAX_PROBES; i++) {
+    struct prof_probe *p = &prof_table[i];
+    if (p->count == 0)
+      continue;
+    prof_fold(p);
+    if (p->name) {
+      print(p->name);
+    } else {
+      print("probe ");
+      print_dec(i);
+    }
+    prof_field(": n=", p->count);
+    prof_field(" avg=", prof_div(p->total_cycles, p->count));
+    prof_field(" min=", p->min_cycles);
+    prof_field(" max=", p->max_cycles);
+    prof_field(" instret/n=", prof_div(p->total_instret, p->count));
+    if (!PROF_HIST) {
+      printc('\n');
+      continue;
+    }
+    print("\n  log2 hist:");
+    for (int b = 0; b < 32; b++) {
+      if (p->hist[b] == 0)
+        continue;
+      printc(' ');
+      console_write(buf, fmt_u32(buf, b));
+      printc(':');
+      console_write(buf, fmt_u32(buf, p->hist[b]));
+    }
+    printc('\n');
+  }
+}
+
+/* function: prof_export
+   Description: Copy the probe table into prof_export_area, which can
+   be read from the host with dtekv-download. Names are truncated to
+   PROF_NAME_LEN - 1 characters. Returns the area's address. */
+struct prof_export *prof_export(void)
+{
+  struct prof_export *e = &prof_export_area;
+
+  e->magic = PROF_EXPORT_MAGIC;
+  e->probes = PROF_MAX_PROBES;
+  for (int i = 0; i < PROF_MAX_PROBES; i++) {
+    const char *name = prof_table[i].name;
+    int n = 0;
+    if (name)
+      for (; n < PROF_NAME_LEN - 1 && name[n] != '\0'; n++)
+        e->names[i][n] = name[n];
+    for (; n < PROF_NAME_LEN; n++)
+      e->names[i][n] = '\0';
+    prof_fold(&prof_table[i]);
+    e->data[i] = prof_table[i];
+    e->data[i].name = 0;
+  }
+  return e;
+}
+
+#endif
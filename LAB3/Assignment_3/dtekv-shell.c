@@ -0,0 +1,355 @@
+/* dtekv-shell.c
+
+   A small line-oriented shell on the JTAG UART, for tuning a running
+   program without rebuilding it. The program registers integer
+   variables with shell_var and commands with shell_cmd, then calls
+   shell_poll from its main loop. Lines arrive two ways: dtekv-shell on
+   the host uploads each one into shell_mailbox with the same JTAG
+   write the loader uses, and characters typed into a JTAG UART
+   terminal come through the interrupt-driven receive ring
+   (uart_rx_init). Polling costs a few loads when nothing came in. The
+   host terminal does the line editing and echo.
+
+   Built in: help, get [name], set name value, prof [reset] and stats
+   (dropped characters, events and work items, timer lateness and
+   emulated instructions). */
+
+#include "dtekv-lib.h"
+
+static struct {
+  const char *name;
+  int *value;
+  int min, max;
+} vars[SHELL_MAX_VARS];
+
+static struct {
+  const char *name;
+  shell_fn fn;
+  const char *usage;
+} cmds[SHELL_MAX_CMDS];
+
+static unsigned nvars, ncmds;
+static char input[SHELL_LINE_SIZE];
+static unsigned input_len;
+static int input_overflow;
+
+/* Written by dtekv-shell, found with nm; .bss starts it at zero. */
+struct shell_mailbox shell_mailbox;
+static unsigned mailbox_seen;   /* head when last polled */
+
+static int same(const char *a, const char *b)
+{
+  while (*a && *a == *b) {
+    a++;
+    b++;
+  }
+  return *a == *b;
+}
+
+static void prompt(void)
+{
+  print("> ");
+}
+
+static void print_int(int x)
+{
+  char buf[FMT_I32_SIZE];
+  console_write(buf, fmt_i32(buf, x));
+}
+
+static void print_var(unsigned i)
+{
+  print(vars[i].name);
+  print(" = ");
+  print_int(*vars[i].value);
+  printc('\n');
+}
+
+static int find_var(const char *name)
+{
+  for (unsigned i = 0; i < nvars; i++)
+    if (same(vars[i].name, name))
+      return i;
+  print("no variable ");
+  print(name);
+  printc('\n');
+  return -1;
+}
+
+static int cmd_help(int argc, char **argv)
+{
+  for (unsigned i = 0; i < ncmds; i++) {
+    print(cmds[i].usage);
+    printc('\n');
+  }
+  return 0;
+}
+
+static int cmd_get(int argc, char **argv)
+{
+  int i;
+
+  if (argc == 1) {
+    for (unsigned v = 0; v < nvars; v++)
+      print_var(v);
+    return 0;
+  }
+  if (argc != 2)
+    return -1;
+  if ((i = find_var(argv[1])) >= 0)
+    print_var(i);
+  return 0;
+}
+
+static int cmd_set(int argc, char **argv)
+{
+  int i, value;
+
+  if (argc != 3)
+    return -1;
+  if (shell_parse_int(argv[2], &value) < 0)
+    return -1;
+  if ((i = find_var(argv[1])) < 0)
+    return 0;
+  if (value < vars[i].min || value > vars[i].max) {
+    print(vars[i].name);
+    print(" must be ");
+    print_int(vars[i].min);
+    print(" to ");
+    print_int(vars[i].max);
+    printc('\n');
+    return 0;
+  }
+  *vars[i].value = value;
+  print_var(i);
+  return 0;
+}
+
+static int cmd_prof(int argc, char **argv)
+{
+  if (!PROF_ENABLE) {
+    print("profiling is off (build with make PROF=1)\n");
+    return 0;
+  }
+  if (argc == 2 && same(argv[1], "reset"))
+    prof_reset();
+  else if (argc == 1)
+    prof_dump();
+  else
+    return -1;
+  return 0;
+}
+
+static int cmd_stats(int argc, char **argv)
+{
+  print("uart: ");
+  print_dec(uart_tx_dropped());
+  print(" tx dropped, ");
+  print_dec(uart_rx_dropped());
+  print(" rx dropped\nqueues: ");
+  print_dec(event_overflows());
+  print(" events dropped, ");
+  print_dec(work_overflows());
+  print(" work items dropped\n");
+  if (timer_tick_cycles())
+    timer_health_dump("timer", timer_service_health());
+  trap_emulate_dump();
+  return 0;
+}
+
+/* function: shell_init
+   Description: Register the built-in commands, enable the receive
+   interrupt and print the first prompt. The handler for JTAG_UART_IRQ
+   must call uart_rx_isr. */
+void shell_init(void)
+{
+  nvars = ncmds = 0;
+  input_len = 0;
+  input_overflow = 0;
+  mailbox_seen = shell_mailbox.head;
+  shell_cmd("help", cmd_help, "help");
+  shell_cmd("get", cmd_get, "get [name]");
+  shell_cmd("set", cmd_set, "set name value");
+  shell_cmd("prof", cmd_prof, "prof [reset]");
+  shell_cmd("stats", cmd_stats, "stats");
+  uart_rx_init();
+  prompt();
+}
+
+/* function: shell_var
+   Description: Make *value readable and writable as name. Returns 0,
+   or -1 if the table is full. */
+int shell_var(const char *name, int *value)
+{
+  return shell_var_range(name, value, (int) 0x80000000u, 0x7FFFFFFF);
+}
+
+/* function: shell_var_range
+   Description: Like shell_var, but set refuses values outside
+   [min, max], for variables the program cannot take just any value
+   in. */
+int shell_var_range(const char *name, int *value, int min, int max)
+{
+  if (nvars == SHELL_MAX_VARS)
+    return -1;
+  vars[nvars].name = name;
+  vars[nvars].value = value;
+  vars[nvars].min = min;
+  vars[nvars].max = max;
+  nvars++;
+  return 0;
+}
+
+/* function: shell_cmd
+   Description: Add a command; usage is its one-line help, starting
+   with the name. Returns 0, or -1 if the table is full. */
+int shell_cmd(const char *name, shell_fn fn, const char *usage)
+{
+  if (ncmds == SHELL_MAX_CMDS)
+    return -1;
+  cmds[ncmds].name = name;
+  cmds[ncmds].fn = fn;
+  cmds[ncmds].usage = usage;
+  ncmds++;
+  return 0;
+}
+
+/* function: shell_parse_int
+   Description: Parse a decimal or 0x-prefixed hexadecimal number, with
+   an optional minus sign. Returns 0, or -1 if s is not a number or
+   does not fit in an int. */
+int shell_parse_int(const char *s, int *value)
+{
+  unsigned x = 0;
+  int neg = 0, digits = 0;
+
+  if (*s == '-') {
+    neg = 1;
+    s++;
+  }
+  if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+    for (s += 2; *s; s++, digits++) {
+      unsigned d;
+      if (*s >= '0' && *s <= '9')
+        d = *s - '0';
+      else if ((*s | 0x20) >= 'a' && (*s | 0x20) <= 'f')
+        d = (*s | 0x20) - 'a' + 10;
+      else
+        return -1;
+      if (x >> 28)
+        return -1;                      /* Would shift out of 32 bits */
+      x = x << 4 | d;
+    }
+  } else {
+    for (; *s; s++, digits++) {
+      if (*s < '0' || *s > '9')
+        return -1;
+      if (x > (0xFFFFFFFF - (*s - '0')) / 10)
+        return -1;                      /* Would wrap past 0xFFFFFFFF */
+      x = x * 10 + (*s - '0');
+    }
+  }
+  if (digits == 0 || x > (neg ? 0x80000000 : 0x7FFFFFFF))
+    return -1;
+  *value = neg ? (int) -x : (int) x;
+  return 0;
+}
+
+/* function: shell_exec
+   Description: Split line into words in place and run the command it
+   names. Returns the command's result, or -1 for an unknown command. */
+int shell_exec(char *line)
+{
+  char *argv[SHELL_MAX_ARGS];
+  int argc = 0;
+
+  while (*line) {
+    while (*line == ' ' || *line == '\t')
+      *line++ = '\0';
+    if (*line == '\0')
+      break;
+    if (argc == SHELL_MAX_ARGS) {
+      print("too many words\n");
+      return -1;
+    }
+    argv[argc++] = line;
+    while (*line && *line != ' ' && *line != '\t')
+      line++;
+  }
+  if (argc == 0)
+    return 0;
+
+  for (unsigned i = 0; i < ncmds; i++) {
+    if (same(cmds[i].name, argv[0])) {
+      if (cmds[i].fn(argc, argv) == 0)
+        return 0;
+      print("usage: ");
+      print(cmds[i].usage);
+      printc('\n');
+      return -1;
+    }
+  }
+  print("unknown command ");
+  print(argv[0]);
+  print(", try help\n");
+  return -1;
+}
+
+/* Run the lines dtekv-shell has put in the mailbox since the last
+   poll. A head more than SHELL_MAILBOX_SLOTS ahead (or behind) is a new
+   dtekv-shell session, and only its newest line is run. So is a burst
+   of more lines than that between two polls: all but the last are
+   lost. */
+static unsigned mailbox_poll(void)
+{
+  unsigned head = shell_mailbox.head, lines = 0;
+  char line[SHELL_LINE_SIZE];
+
+  if (head - mailbox_seen > SHELL_MAILBOX_SLOTS)
+    mailbox_seen = head - 1;
+  RING_BARRIER();                       /* Read head before the text */
+  while (mailbox_seen != head) {
+    const char *src = shell_mailbox.line[mailbox_seen & (SHELL_MAILBOX_SLOTS - 1)];
+    unsigned i;
+
+    for (i = 0; i < SHELL_LINE_SIZE - 1 && src[i] != '\0'; i++)
+      line[i] = src[i];
+    line[i] = '\0';
+    mailbox_seen++;
+    shell_exec(line);
+    prompt();
+    lines++;
+  }
+  return lines;
+}
+
+/* function: shell_poll
+   Description: Take whatever has been received and run each completed
+   line. Call from the main loop; returns the number of lines run. */
+unsigned shell_poll(void)
+{
+  unsigned lines = mailbox_poll();
+  int c;
+
+  while ((c = uart_getc()) >= 0) {
+    if (c == '\r')
+      continue;
+    if (c != '\n') {
+      if (input_len < SHELL_LINE_SIZE - 1)
+        input[input_len++] = c;
+      else
+        input_overflow = 1;
+      continue;
+    }
+    input[input_len] = '\0';
+    if (input_overflow)
+      print("line too long\n");
+    else
+      shell_exec(input);
+    input_len = 0;
+    input_overflow = 0;
+    lines++;
+    prompt();
+  }
+  return lines;
+}
@@ -0,0 +1,171 @@
+/* dtekv-sieve.c
+
+   Segmented sieve of Eratosthenes producing consecutive primes.
+
+   Only odd numbers are stored, one bit each (1 = composite), in two
+   segment buffers taken from a caller-supplied work area. The front
+   segment is scanned by prime_stream_next while the back segment is
+   sieved a few strikes at a time on every call, so the cost of
+   preparing the next segment is spread over the primes that precede
+   it instead of landing on one call. Sieving primes are obtained
+   from nextprime as the stream grows and kept, together with their
+   next multiple, after the segment buffers in the work area.
+
+   Larger segments amortize the per-segment work (clearing the bitmap,
+   visiting every sieving prime) over more primes, but cost more memory
+   and a longer worst-case call when a segment is swapped in;
+   Benchmarks/bench_sieve.c measures both. */
+
+#include "dtekv-lib.h"
+
+#define SEG_BITS(ps) ((ps)->words * 32)
+
+/* Make sure every prime up to sqrt(end) is in the sieving table and
+   give new entries their first multiple inside the back segment.
+   Returns 0 if the table is full. */
+static int add_sieving_primes(struct prime_stream *ps, unsigned long long end)
+{
+  unsigned last = ps->nsieving ? ps->sieving[ps->nsieving - 1] : 2;
+
+  while ((unsigned long long) last * last < end) {
+    unsigned p, d;
+    if (ps->nsieving == ps->maxsieving)
+      return 0;
+    p = nextprime(last);
+    /* Distance from back_base to the first odd multiple of p that is
+       >= max(p*p, back_base). Kept as a distance, since the multiple
+       itself may not fit in 32 bits near the top. back_base is odd,
+       so an odd distance would land on an even multiple. */
+    if ((unsigned long long) p * p >= ps->back_base) {
+      d = p * p - ps->back_base;
+    } else {
+      d = ps->back_base % p;
+      d = d ? p - d : 0;
+      if (d & 1)
+        d += p;
+    }
+    ps->sieving[ps->nsieving] = p;
+    ps->offset[ps->nsieving] = d >> 1;
+    ps->nsieving++;
+    last = p;
+  }
+  return 1;
+}
+
+/* Start a fresh back segment at base. If the sieving table cannot cover
+   it, or it would run past 2^32, the back segment is marked unusable
+   and the stream ends with the front one. */
+static void begin_back(struct prime_stream *ps, unsigned base)
+{
+  unsigned long long end = (unsigned long long) base + 2 * SEG_BITS(ps);
+
+  ps->back_base = base;
+  ps->back_done = 0;
+  if (end > 0x100000000ull || !add_sieving_primes(ps, end)) {
+    ps->last_segment = 1;
+    return;
+  }
+  memset(ps->back, 0, ps->words * 4);
+  if (base == 1)
+    ps->back[0] = 1;                 /* 1 is not prime */
+}
+
+/* Strike up to budget multiples into the back segment; budget 0 means
+   finish it. */
+static void sieve_back(struct prime_stream *ps, unsigned budget)
+{
+  unsigned nbits = SEG_BITS(ps);
+  unsigned *bits = ps->back;
+
+  while (ps->back_done < ps->nsieving) {
+    unsigned i = ps->back_done;
+    unsigned p = ps->sieving[i];
+    unsigned o = ps->offset[i];
+
+    while (o < nbits) {
+      bits[o >> 5] |= 1u << (o & 31);
+      o += p;
+      if (budget != 0 && --budget == 0) {
+        ps->offset[i] = o;
+        return;
+      }
+    }
+    ps->offset[i] = o - nbits;
+    ps->back_done++;
+  }
+}
+
+/* Finish the back segment and make it the front. */
+static void advance(struct prime_stream *ps)
+{
+  unsigned *t = ps->front;
+
+  if (ps->last_segment) {
+    ps->exhausted = 1;
+    return;
+  }
+  sieve_back(ps, 0);
+  ps->front = ps->back;
+  ps->back = t;
+  ps->front_base = ps->back_base;
+  ps->pos = 0;
+  begin_back(ps, ps->front_base + 2 * SEG_BITS(ps));
+}
+
+/* function: prime_stream_init
+   Description: Prepare a stream yielding the primes greater than start.
+   work/work_words is the memory the stream may use: two segments of
+   segment_words words each, plus two words per sieving prime. Sieving
+   every 32-bit number needs 6542 sieving primes; with fewer the stream
+   ends early (prime_stream_next returns 0). */
+void prime_stream_init(struct prime_stream *ps, unsigned start, unsigned *work,
+                       unsigned work_words, unsigned segment_words)
+{
+  unsigned first = (start + 1) | 1;  /* First odd number above start */
+
+  ps->words = segment_words;
+  ps->front = work;
+  ps->back = work + segment_words;
+  ps->maxsieving = (work_words - 2 * segment_words) / 2;
+  ps->sieving = work + 2 * segment_words;
+  ps->offset = ps->sieving + ps->maxsieving;
+  ps->nsieving = 0;
+  ps->emit_two = start < 2;
+  ps->last_segment = 0;
+  ps->exhausted = first < start;     /* start was already at the top */
+
+  if (!ps->exhausted) {
+    begin_back(ps, first);
+    advance(ps);
+  }
+}
+
+/* function: prime_stream_next
+   Description: Return the next prime of the stream, or 0 once it has
+   run past 2^32 or past what its sieving table can cover. */
+unsigned prime_stream_next(struct prime_stream *ps)
+{
+  if (ps->emit_two) {
+    ps->emit_two = 0;
+    return 2;
+  }
+
+  while (!ps->exhausted) {
+    unsigned nbits = SEG_BITS(ps);
+
+    if (!ps->last_segment)
+      sieve_back(ps, PRIME_STREAM_STEP);
+
+    while (ps->pos < nbits) {
+      unsigned w = ~ps->front[ps->pos >> 5] >> (ps->pos & 31);
+      if (w != 0) {
+        unsigned bit = ps->pos + bit_lowest(w);
+        ps->pos = bit + 1;
+        return ps->front_base + 2 * bit;
+      }
+      ps->pos = (ps->pos | 31) + 1;
+    }
+    advance(ps);
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+/* dtekv-stack.c
+
+   Stack watermarks. _start fills the boot stack with STACK_PAINT
+   before anything runs on it, and task_create does the same for each
+   task stack, so the deepest word ever written is the lowest one that
+   no longer holds the pattern. stack_peak finds it for any region;
+   the wrappers cover the boot stack and task stacks.
+
+   There is no separate interrupt stack: _isr_routine and _irq_fast
+   push their frames (144 and 80 bytes) onto whatever stack was
+   running, so each watermark already includes the deepest interrupt
+   that landed on that stack. make stack reads the boot stack back
+   with dtekv-download and suggests a __stack_size (stack-size.py). */
+
+#include "dtekv-lib.h"
+
+extern char _stack_begin[], _stack_end[];
+
+/* function: stack_paint
+   Description: Fill [lo, hi) with STACK_PAINT, whole words only. Must
+   not be the stack in use. */
+void stack_paint(void *lo, void *hi)
+{
+  unsigned *p = (unsigned *) (((unsigned) lo + 3) & ~3u);
+  unsigned *end = (unsigned *) ((unsigned) hi & ~3u);
+
+  while (p < end)
+    *p++ = STACK_PAINT;
+}
+
+/* function: stack_peak
+   Description: Bytes of the painted stack [lo, hi) that have been
+   used, counting down from hi to the lowest overwritten word. */
+unsigned stack_peak(const void *lo, const void *hi)
+{
+  const unsigned *p = (const unsigned *) (((unsigned) lo + 3) & ~3u);
+  const unsigned *end = (const unsigned *) ((unsigned) hi & ~3u);
+
+  while (p < end && *p == STACK_PAINT)
+    p++;
+  return (unsigned) hi - (unsigned) p;
+}
+
+/* function: stack_main_peak
+   Description: Peak use of the boot stack (main and, after task_init,
+   the "main" task). */
+unsigned stack_main_peak(void)
+{
+  return stack_peak(_stack_begin, _stack_end);
+}
+
+/* function: stack_main_size
+   Description: Size of the boot stack, i.e. __stack_size. */
+unsigned stack_main_size(void)
+{
+  return _stack_end - _stack_begin;
+}
+
+/* function: task_stack_peak
+   Description: Peak use of t's stack; the boot stack for the task
+   task_init adopted. */
+unsigned task_stack_peak(const struct task *t)
+{
+  if (t->stack == 0)
+    return stack_main_peak();
+  return stack_peak(t->stack, (char *) t->stack + t->stack_size);
+}
+
+/* function: task_stack_dump
+   Description: Print "name: peak of size bytes" for t's stack. */
+void task_stack_dump(const struct task *t)
+{
+  print(t->name);
+  print(": stack peak ");
+  print_dec(task_stack_peak(t));
+  print(" of ");
+  print_dec(t->stack ? t->stack_size : stack_main_size());
+  print(" bytes\n");
+}
@@ -0,0 +1,157 @@
+/* dtekv-string.c
+
+   memcpy, memmove, memset and memcmp for the -nostdlib build. GCC also
+   calls these itself for structure copies and zeroing, even with
+   -fno-builtin.
+
+   Copies and fills first align the destination with byte moves, then
+   run an eight-word unrolled loop, single words, and a byte tail. When
+   the source cannot be aligned along with the destination, memcpy
+   still reads whole aligned words and merges neighbours with shifts
+   (little endian), so it never falls back to a byte loop. memcmp
+   compares a word at a time while both sides share alignment. */
+
+#include "dtekv-lib.h"
+
+/* Keep GCC from turning the loops below back into calls to themselves. */
+#pragma GCC optimize ("no-tree-loop-distribute-patterns")
+
+typedef unsigned word;
+
+/* Copy n bytes from word-aligned s to word-aligned d, n a multiple of 4. */
+static void copy_words(word *d, const word *s, unsigned n)
+{
+  for (; n >= 32; n -= 32, d += 8, s += 8) {
+    word w0 = s[0], w1 = s[1], w2 = s[2], w3 = s[3];
+    word w4 = s[4], w5 = s[5], w6 = s[6], w7 = s[7];
+    d[0] = w0; d[1] = w1; d[2] = w2; d[3] = w3;
+    d[4] = w4; d[5] = w5; d[6] = w6; d[7] = w7;
+  }
+  for (; n >= 4; n -= 4)
+    *d++ = *s++;
+}
+
+/* function: memcpy
+   Description: Copy n bytes; the areas must not overlap. */
+void *memcpy(void *dst, const void *src, unsigned n)
+{
+  unsigned char *d = dst;
+  const unsigned char *s = src;
+
+  if (n >= 8) {
+    while ((unsigned) d & 3) {
+      *d++ = *s++;
+      n--;
+    }
+    if (((unsigned) s & 3) == 0) {
+      copy_words((word *) d, (const word *) s, n & ~3u);
+    } else {
+      /* Source off by 1-3 bytes: shift pairs of aligned words */
+      unsigned shift = ((unsigned) s & 3) * 8;
+      const word *sw = (const word *) ((unsigned) s & ~3u);
+      word *dw = (word *) d, w0 = *sw++;
+      for (unsigned k = n >> 2; k > 0; k--) {
+        word w1 = *sw++;
+        *dw++ = (w0 >> shift) | (w1 << (32 - shift));
+        w0 = w1;
+      }
+    }
+    d += n & ~3u;
+    s += n & ~3u;
+    n &= 3;
+  }
+  while (n--)
+    *d++ = *s++;
+  return dst;
+}
+
+/* function: memmove
+   Description: Copy n bytes; the areas may overlap. */
+void *memmove(void *dst, const void *src, unsigned n)
+{
+  unsigned char *d = dst;
+  const unsigned char *s = src;
+
+  if (d <= s || d >= s + n)
+    return memcpy(dst, src, n);   /* memcpy runs forwards */
+
+  /* Destination above an overlapping source: copy backwards */
+  d += n;
+  s += n;
+  if ((((unsigned) d ^ (unsigned) s) & 3) == 0) {
+    while (n && ((unsigned) d & 3)) {
+      *--d = *--s;
+      n--;
+    }
+    for (; n >= 16; n -= 16) {
+      word *dw = (word *) d - 4;
+      const word *sw = (const word *) s - 4;
+      word w3 = sw[3], w2 = sw[2], w1 = sw[1], w0 = sw[0];
+      dw[3] = w3; dw[2] = w2; dw[1] = w1; dw[0] = w0;
+      d -= 16;
+      s -= 16;
+    }
+    for (; n >= 4; n -= 4) {
+      d -= 4;
+      s -= 4;
+      *(word *) d = *(const word *) s;
+    }
+  }
+  while (n--)
+    *--d = *--s;
+  return dst;
+}
+
+/* function: memset
+   Description: Fill n bytes with the byte c. */
+void *memset(void *dst, int c, unsigned n)
+{
+  unsigned char *d = dst;
+
+  if (n >= 8) {
+    word w = (c & 0xFF) * 0x01010101u, *dw;
+    while ((unsigned) d & 3) {
+      *d++ = c;
+      n--;
+    }
+    dw = (word *) d;
+    for (; n >= 32; n -= 32, dw += 8) {
+      dw[0] = w; dw[1] = w; dw[2] = w; dw[3] = w;
+      dw[4] = w; dw[5] = w; dw[6] = w; dw[7] = w;
+    }
+    for (; n >= 4; n -= 4)
+      *dw++ = w;
+    d = (unsigned char *) dw;
+  }
+  while (n--)
+    *d++ = c;
+  return dst;
+}
+
+/* function: memcmp
+   Description: Compare n bytes; negative, zero or positive like the
+   first differing byte (as unsigned char). */
+int memcmp(const void *a, const void *b, unsigned n)
+{
+  const unsigned char *p = a, *q = b;
+
+  if (n >= 8 && (((unsigned) p ^ (unsigned) q) & 3) == 0) {
+    while ((unsigned) p & 3) {
+      if (*p != *q)
+        return *p - *q;
+      p++;
+      q++;
+      n--;
+    }
+    /* Skip equal words; the byte loop finds the difference inside */
+    while (n >= 4 && *(const word *) p == *(const word *) q) {
+      p += 4;
+      q += 4;
+      n -= 4;
+    }
+  }
+  for (; n; n--, p++, q++)
+    if (*p != *q)
+      return *p - *q;
+  return 0;
+}
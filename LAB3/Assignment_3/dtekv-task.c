@@ -0,0 +1,191 @@
+/* dtekv-task.c
+
+   Cooperative scheduler with stackful tasks.
+
+   task_init adopts the boot stack as the first task ("main"); more
+   tasks get stacks carved from the .task_stacks region of the linker
+   script. Tasks run until they call task_yield, task_sleep or
+   task_exit, so nothing is preempted and task code needs no locking
+   against other tasks, only against interrupt handlers. The run queue
+   is a FIFO; interrupt handlers may make a task ready with task_wake.
+   task_sleep hangs a one-shot soft timer on the timer service, so
+   timer_service_init must have been called. When no task is ready the
+   CPU waits in wfi. */
+
+#include "dtekv-lib.h"
+
+extern char _task_stacks_begin[], _task_stacks_end[];
+extern void task_switch(unsigned *save_sp, unsigned new_sp);
+extern void task_entry(void);
+
+/* Offsets in the 16-word frame built by switch.S */
+#define FRAME_WORDS   16
+#define FRAME_RA      0
+#define FRAME_S0      1
+#define FRAME_S1      2
+#define FRAME_MSTATUS 13
+
+static struct task main_task;
+static struct task *current;
+static struct task *run_head, *run_tail;
+static char *stack_next = _task_stacks_begin;
+
+/* Append t to the run queue. Interrupts must be off. */
+static void ready(struct task *t)
+{
+  t->state = TASK_READY;
+  t->next = 0;
+  if (run_tail)
+    run_tail->next = t;
+  else
+    run_head = t;
+  run_tail = t;
+}
+
+/* Switch to the first ready task, waiting for one if there is none.
+   The caller has set current's state and holds interrupts off. */
+static void schedule(void)
+{
+  struct task *prev = current, *next;
+
+  while ((next = run_head) == 0) {
+    asm volatile ("wfi");
+    asm volatile ("csrsi mstatus, 8\n\tcsrci mstatus, 8" ::: "memory");   /* Take it */
+  }
+  run_head = next->next;
+  if (run_head == 0)
+    run_tail = 0;
+  next->state = TASK_RUNNING;
+  if (next == prev)
+    return;
+  current = next;
+  task_switch(&prev->sp, next->sp);
+}
+
+static void sleep_expired(unsigned arg)
+{
+  task_wake((struct task *) arg);
+}
+
+/* SYS_YIELD: the tasks that run meanwhile take traps of their own, but
+   _isr_routine keeps mepc in the trap frame, so nothing to restore. */
+static unsigned sys_task_yield(unsigned a0, unsigned a1, unsigned a2,
+                               unsigned a3, unsigned a4, unsigned a5)
+{
+  task_yield();
+  return 0;
+}
+
+/* function: task_init
+   Description: Make the caller (running on the boot stack) the first
+   task and route the SYS_YIELD ecall to the scheduler. */
+void task_init(void)
+{
+  main_task.name = "main";
+  main_task.state = TASK_RUNNING;
+  current = &main_task;
+  syscall_register(SYS_YIELD, sys_task_yield);
+}
+
+/* function: task_create
+   Description: Make a ready task running fn(arg) on a fresh stack of
+   stack_bytes bytes. Returns 0, or -1 if the stack region is used up.
+   Stacks are never given back, so create tasks once at start-up. */
+int task_create(struct task *t, const char *name, void (*fn)(unsigned),
+                unsigned arg, unsigned stack_bytes)
+{
+  unsigned flags;
+  unsigned *frame;
+
+  stack_bytes = (stack_bytes + 15) & ~15u;
+  if (stack_bytes < 4 * FRAME_WORDS ||
+      stack_bytes > (unsigned) (_task_stacks_end - stack_next))
+    return -1;
+
+  t->name = name;
+  t->stack = (unsigned *) stack_next;
+  t->stack_size = stack_bytes;
+  stack_next += stack_bytes;
+
+  /* A frame that task_switch "returns" through into task_entry, with
+     the rest painted for task_stack_peak */
+  frame = (unsigned *) stack_next - FRAME_WORDS;
+  stack_paint(t->stack, frame);
+  frame[FRAME_RA] = (unsigned) task_entry;
+  frame[FRAME_S0] = (unsigned) fn;
+  frame[FRAME_S1] = arg;
+  asm volatile ("csrr %0, mstatus" : "=r"(frame[FRAME_MSTATUS]));
+  t->sp = (unsigned) frame;
+
+  flags = irq_save();
+  ready(t);
+  irq_restore(flags);
+  return 0;
+}
+
+/* function: task_yield
+   Description: Let every other ready task run once before returning. */
+void task_yield(void)
+{
+  unsigned flags = irq_save();
+  if (run_head) {
+    ready(current);
+    schedule();
+  }
+  irq_restore(flags);
+}
+
+/* function: task_sleep
+   Description: Block the calling task for ticks timer ticks. */
+void task_sleep(unsigned ticks)
+{
+  unsigned flags = irq_save();
+  current->state = TASK_SLEEPING;
+  timer_start(&current->timer, ticks, 0, sleep_expired, (unsigned) current);
+  schedule();
+  irq_restore(flags);
+}
+
+/* function: task_sleep_until
+   Description: Block until timer_now() reaches tick; just yields if it
+   already has. Sleeping to successive deadlines does not drift. */
+void task_sleep_until(unsigned tick)
+{
+  int left = (int) (tick - timer_now());
+
+  if (left > 0)
+    task_sleep(left);
+  else
+    task_yield();
+}
+
+/* function: task_wake
+   Description: Make a sleeping task ready, cancelling its timer.
+   Callable from interrupt handlers. */
+void task_wake(struct task *t)
+{
+  unsigned flags = irq_save();
+  if (t->state == TASK_SLEEPING) {
+    timer_cancel(&t->timer);
+    ready(t);
+  }
+  irq_restore(flags);
+}
+
+/* function: task_exit
+   Description: End the calling task. Returning from its function does
+   the same. Does not return. */
+void task_exit(void)
+{
+  irq_save();
+  current->state = TASK_DEAD;
+  schedule();
+  while (1);
+}
+
+/* function: task_current
+   Description: The running task. */
+struct task *task_current(void)
+{
+  return current;
+}
@@ -0,0 +1,364 @@
+/* dtekv-timer.c
+
+   Software timers multiplexed onto the single Avalon interval timer.
+
+   Timers live in a hashed timing wheel of TIMER_WHEEL_SLOTS lists,
+   indexed by expiry tick modulo the wheel size, so starting and
+   cancelling are O(1) list operations. The hardware does not tick
+   periodically: it is programmed as a one-shot for the distance to
+   the nearest non-empty slot (found through a bitmap), or for a full
+   wheel turn when nothing is pending so timer_now keeps counting.
+   When an earlier deadline is added while it runs, the elapsed time
+   is read from the snapshot registers and the timer is restarted,
+   carrying the partial tick so no time is lost. timer_isr likewise
+   carries the cycles spent since the deadline (interrupt entry and
+   the callbacks) into the next one-shot. They are counted with mcycle
+   from tick_start, where the tick should have begun, so even the few
+   cycles it takes to restart the hardware do not add up to drift.
+   Callbacks run in interrupt context from timer_isr; longer work
+   should be handed to work_queue.
+
+   timer_isr also checks, with mcycle, how long after the programmed
+   deadline it ran. Those counters, and the timer_health_* helpers for
+   programs that run the Avalon timer in continuous mode themselves,
+   show interrupts that came late or not at all. */
+
+#include "dtekv-lib.h"
+
+#define TIMER ((volatile int *) 0x04000020)
+#define TMR_STATUS  0
+#define TMR_CONTROL 1
+#define TMR_PERIODL 2
+#define TMR_PERIODH 3
+#define TMR_SNAPL   4
+#define TMR_SNAPH   5
+
+#define TMR_ITO   0x1   /* Interrupt on timeout */
+#define TMR_START 0x4
+#define TMR_STOP  0x8
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+#define ST_IDLE    0
+#define ST_PENDING 1
+#define ST_FIRING  2
+
+static struct soft_timer *wheel[TIMER_WHEEL_SLOTS];
+static unsigned wheel_bitmap[TIMER_WHEEL_SLOTS / 32];
+static unsigned tick_cycles;      /* Cycles per tick */
+static unsigned max_ticks;        /* Longest one-shot the hardware can time */
+static unsigned now;              /* Tick at which the hardware was last started */
+static unsigned armed;            /* Ticks until the hardware fires, 0 if stopped */
+static unsigned armed_cycles;     /* Cycles programmed for that */
+static unsigned armed_partial;    /* Cycles of tick `now` already gone at start */
+static int dispatching;           /* Inside timer_isr's callback loop */
+static unsigned armed_at;         /* mcycle when the hardware was started */
+static unsigned tick_start;       /* mcycle at the start of tick `now` */
+static struct timer_health service_health;
+
+static void insert(struct soft_timer *t)
+{
+  unsigned slot = t->expiry & SLOT_MASK;
+
+  t->prev = 0;
+  t->next = wheel[slot];
+  if (t->next)
+    t->next->prev = t;
+  wheel[slot] = t;
+  wheel_bitmap[slot >> 5] |= 1u << (slot & 31);
+  t->state = ST_PENDING;
+}
+
+static void unlink(struct soft_timer *t)
+{
+  unsigned slot = t->expiry & SLOT_MASK;
+
+  if (t->prev)
+    t->prev->next = t->next;
+  else
+    wheel[slot] = t->next;
+  if (t->next)
+    t->next->prev = t->prev;
+  if (wheel[slot] == 0)
+    wheel_bitmap[slot >> 5] &= ~(1u << (slot & 31));
+}
+
+/* Program a one-shot of ticks ticks, minus the cycles since the start
+   of tick `now` that have already gone by. If those reach the deadline,
+   it moves to the next tick boundary still ahead. */
+static void hw_arm(unsigned ticks, unsigned partial)
+{
+  unsigned cycles;
+
+  if (ticks > max_ticks)
+    ticks = max_ticks;
+  cycles = ticks * tick_cycles;
+  while (cycles <= partial) {
+    ticks++;
+    cycles += tick_cycles;
+  }
+  cycles -= partial;
+  armed = ticks;
+  armed_cycles = cycles;
+  armed_partial = partial;
+  TIMER[TMR_PERIODL] = (cycles - 1) & 0xFFFF;   /* Writing the period stops the timer */
+  TIMER[TMR_PERIODH] = (cycles - 1) >> 16;
+  TIMER[TMR_STATUS] = 0;
+  armed_at = mcycle_now();
+  TIMER[TMR_CONTROL] = TMR_ITO | TMR_START;
+}
+
+static void health_record(struct timer_health *h, unsigned latency,
+                          unsigned missed)
+{
+  h->irqs++;
+  h->missed += missed;
+  if (latency > h->late_cycles)
+    h->late++;
+  if (latency > h->max_latency)
+    h->max_latency = latency;
+}
+
+/* Cycles since the start of tick `now`. */
+static unsigned hw_elapsed(void)
+{
+  unsigned remaining;
+
+  TIMER[TMR_SNAPL] = 0;                          /* Latch the counter */
+  remaining = (TIMER[TMR_SNAPL] & 0xFFFF) | (TIMER[TMR_SNAPH] << 16);
+  /* Status after the snapshot: a one-shot that ran out before it has
+     already reloaded, and remaining would be nearly a full period. */
+  if (TIMER[TMR_STATUS] & 1)
+    return armed * tick_cycles;                  /* Expired, ISR not run yet */
+  return armed_partial + armed_cycles - 1 - remaining;
+}
+
+/* Distance in ticks from now to the nearest non-empty slot, or 0. */
+static unsigned next_distance(void)
+{
+  unsigned start = (now + 1) & SLOT_MASK;
+
+  for (unsigned d = 0; d < TIMER_WHEEL_SLOTS; ) {
+    unsigned slot = (start + d) & SLOT_MASK;
+    unsigned bits = wheel_bitmap[slot >> 5] >> (slot & 31);
+    if (bits)
+      return d + bit_lowest(bits) + 1;
+    d += 32 - (slot & 31);
+  }
+  return 0;
+}
+
+/* function: timer_service_init
+   Description: Take over the Avalon timer with ticks of tick_cycles
+   clock cycles (e.g. 30000 for 1 ms at 30 MHz). The caller routes
+   interrupt 16 to timer_isr. */
+void timer_service_init(unsigned cycles_per_tick)
+{
+  tick_cycles = cycles_per_tick;
+  timer_health_init(&service_health, cycles_per_tick, TIMER_LATE_CYCLES);
+  max_ticks = 0xFFFFFFFFu / cycles_per_tick;
+  if (max_ticks > TIMER_WHEEL_SLOTS)
+    max_ticks = TIMER_WHEEL_SLOTS;
+  now = 0;
+  TIMER[TMR_CONTROL] = TMR_STOP;
+  tick_start = mcycle_now();
+  hw_arm(max_ticks, 0);
+}
+
+/* function: timer_now
+   Description: Current time in ticks. */
+unsigned timer_now(void)
+{
+  unsigned flags = irq_save();
+  unsigned t = now + hw_elapsed() / tick_cycles;
+  irq_restore(flags);
+  return t;
+}
+
+/* function: timer_tick_cycles
+   Description: Cycles per tick, or 0 before timer_service_init. */
+unsigned timer_tick_cycles(void)
+{
+  return tick_cycles;
+}
+
+/* function: timer_service_health
+   Description: Lateness counters kept by timer_isr. A missed period is
+   a whole tick that went by between the deadline and the handler. */
+struct timer_health *timer_service_health(void)
+{
+  return &service_health;
+}
+
+/* function: timer_health_init
+   Description: Start counting for a timer interrupt every period
+   cycles; latencies above late_cycles count as late. For an Avalon
+   timer in continuous mode, call it as the timer is started. */
+void timer_health_init(struct timer_health *h, unsigned period,
+                       unsigned late_cycles)
+{
+  h->period = period;
+  h->late_cycles = late_cycles;
+  h->last_timeout = mcycle_now();
+  h->irqs = h->late = h->missed = h->max_latency = 0;
+}
+
+/* function: timer_health_tick
+   Description: Call first thing in the interrupt handler of an Avalon
+   timer running in continuous mode with h's period, before the
+   interrupt is acknowledged. The snapshot registers give the cycles
+   since the counter reloaded, which is the latency; mcycle tells
+   whether whole periods went by in between. Returns the latency. */
+unsigned timer_health_tick(struct timer_health *h)
+{
+  unsigned cycle = mcycle_now(), count, latency, timeout, gap;
+  unsigned missed = 0;
+
+  TIMER[TMR_SNAPL] = 0;                          /* Latch the counter */
+  count = (TIMER[TMR_SNAPL] & 0xFFFF) | (TIMER[TMR_SNAPH] << 16);
+  latency = h->period - 1 - count;
+  timeout = cycle - latency;
+  gap = timeout - h->last_timeout;
+  h->last_timeout = timeout;
+  if (gap > h->period + h->period / 2)
+    missed = (gap + h->period / 2) / h->period - 1;
+  health_record(h, latency, missed);
+  return latency;
+}
+
+/* function: timer_health_dump
+   Description: Print the counters on one line. */
+void timer_health_dump(const char *name, const struct timer_health *h)
+{
+  print(name);
+  print(": ");
+  print_dec(h->irqs);
+  print(" irqs, ");
+  print_dec(h->late);
+  print(" late, ");
+  print_dec(h->missed);
+  print(" missed, max latency ");
+  print_dec(h->max_latency);
+  print(" cycles\n");
+}
+
+/* function: timer_start
+   Description: Call fn(arg) after delay ticks (at least 1), then every
+   period ticks unless period is 0. Restarting a pending timer moves it. */
+void timer_start(struct soft_timer *t, unsigned delay, unsigned period,
+                 work_fn fn, unsigned arg)
+{
+  unsigned flags = irq_save();
+  unsigned partial = 0;
+
+  if (t->state == ST_PENDING)
+    unlink(t);
+  if (delay == 0)
+    delay = 1;
+
+  if (!dispatching) {
+    unsigned elapsed = hw_elapsed();
+    unsigned ticks = elapsed / tick_cycles;
+    if (delay < armed - ticks) {
+      /* Earlier than the programmed wake-up: restart from here. */
+      now += ticks;
+      partial = elapsed - ticks * tick_cycles;
+      tick_start += ticks * tick_cycles;
+      armed = 0;
+    } else {
+      delay += ticks;   /* Expiry relative to tick `now` */
+    }
+  }
+
+  t->expiry = now + delay;
+  t->period = period;
+  t->fn = fn;
+  t->arg = arg;
+  insert(t);
+
+  if (armed == 0 && !dispatching)
+    hw_arm(delay, partial);
+  irq_restore(flags);
+}
+
+/* function: timer_cancel
+   Description: Stop t if it is pending. The hardware keeps its current
+   deadline; an early wake-up with nothing to do is cheaper than
+   re-timing it. */
+void timer_cancel(struct soft_timer *t)
+{
+  unsigned flags = irq_save();
+  if (t->state == ST_PENDING)
+    unlink(t);
+  t->state = ST_IDLE;
+  irq_restore(flags);
+}
+
+/* function: timer_isr
+   Description: Call from handle_interrupt for cause 16. Fires every
+   timer due by now and programs the next wake-up. */
+void timer_isr(void)
+{
+  struct soft_timer *fired = 0, **last = &fired;
+  unsigned from, d;
+  int late;
+
+  if ((TIMER[TMR_STATUS] & 1) == 0)
+    return;
+  TIMER[TMR_STATUS] = 0;
+
+  late = (int) (mcycle_now() - armed_at - armed_cycles);
+  if (late < 0)
+    late = 0;
+  health_record(&service_health, late,
+                late >= tick_cycles ? late / tick_cycles : 0);
+
+  from = now;
+  now += armed;
+
+  /* Unlink everything due into a private list first, so callbacks may
+     start or cancel any timer, themselves included. The list has its
+     own link, since a callback that restarts a timer still on it puts
+     that timer back in the wheel through next. */
+  for (unsigned tick = from + 1; tick - from <= armed; tick++) {
+    unsigned slot = tick & SLOT_MASK;
+    struct soft_timer *t, *next;
+
+    if ((wheel_bitmap[slot >> 5] & (1u << (slot & 31))) == 0)
+      continue;
+    for (t = wheel[slot]; t; t = next) {
+      next = t->next;
+      if ((int) (t->expiry - now) <= 0) {
+        unlink(t);
+        t->state = ST_FIRING;
+        t->fired_next = 0;
+        *last = t;
+        last = &t->fired_next;
+      }
+    }
+  }
+
+  armed = 0;
+  dispatching = 1;
+  while (fired) {
+    struct soft_timer *t = fired;
+    fired = t->fired_next;
+    if (t->state != ST_FIRING)
+      continue;                       /* Cancelled or restarted by an earlier callback */
+    if (t->period) {
+      t->expiry = now + t->period;
+      insert(t);
+    } else {
+      t->state = ST_IDLE;
+    }
+    t->fn(t->arg);
+  }
+  dispatching = 0;
+
+  /* Timers started by the callbacks are in the wheel by now. Tick
+     `now` began at the deadline just served. */
+  tick_start += (now - from) * tick_cycles;
+  d = next_distance();
+  late = (int) (mcycle_now() - tick_start);
+  hw_arm(d ? d : max_ticks, late > 0 ? late : 0);
+}
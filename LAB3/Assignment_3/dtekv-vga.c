@@ -0,0 +1,182 @@
+/* dtekv-vga.c
+
+   Drawing on the 320x240 VGA output, one byte (RGB 3-3-2) per pixel.
+
+   The screen buffer at 0x08000000 holds two frames. The pixel buffer
+   DMA controller at 0x04000100 scans one of them out while everything
+   draws into the other; vga_swap hands the finished frame to the
+   controller, which switches at the next vertical sync, so a frame is
+   never shown half drawn. Fills and blits are memset and memcpy per
+   row, and every drawing call clips to the screen. */
+
+#include "dtekv-lib.h"
+
+#define VGA_DMA    ((volatile int *) 0x04000100)
+#define DMA_BUFFER      0   /* Write: swap buffer and back buffer at vsync */
+#define DMA_BACKBUFFER  1   /* Address of the frame to show next */
+#define DMA_STATUS      3   /* Bit 0 set while a swap is pending */
+
+#define FRAME0 ((unsigned char *) 0x08000000)
+#define FRAME1 (FRAME0 + VGA_FRAME_BYTES)
+
+static unsigned char *back = FRAME1;    /* Frame being drawn */
+
+/* Clip x, y, w, h to the screen; returns 0 if nothing is left. The
+   offsets cut from the left and top go to *dx and *dy. */
+static int clip(int *x, int *y, int *w, int *h, int *dx, int *dy)
+{
+  *dx = *x < 0 ? -*x : 0;
+  *dy = *y < 0 ? -*y : 0;
+  *x += *dx;
+  *y += *dy;
+  *w -= *dx;
+  *h -= *dy;
+  if (*x + *w > VGA_WIDTH)
+    *w = VGA_WIDTH - *x;
+  if (*y + *h > VGA_HEIGHT)
+    *h = VGA_HEIGHT - *y;
+  return *w > 0 && *h > 0;
+}
+
+/* function: vga_init
+   Description: Show frame 0 and draw into frame 1 from now on. */
+void vga_init(void)
+{
+  VGA_DMA[DMA_BACKBUFFER] = (int) FRAME0;
+  VGA_DMA[DMA_BUFFER] = 1;
+  while (VGA_DMA[DMA_STATUS] & 1)
+    ;
+  back = FRAME1;
+}
+
+/* function: vga_back
+   Description: The frame being drawn, VGA_WIDTH bytes per row. */
+unsigned char *vga_back(void)
+{
+  return back;
+}
+
+/* function: vga_swap
+   Description: Show the frame just drawn from the next vertical sync
+   and draw into the other one. Waits for the switch, since until then
+   the other frame is still on screen. */
+void vga_swap(void)
+{
+  unsigned char *shown = back == FRAME0 ? FRAME1 : FRAME0;
+
+  VGA_DMA[DMA_BACKBUFFER] = (int) back;
+  VGA_DMA[DMA_BUFFER] = 1;
+  while (VGA_DMA[DMA_STATUS] & 1)
+    ;
+  back = shown;
+}
+
+/* function: vga_clear
+   Description: Fill the whole back frame with color. */
+void vga_clear(unsigned color)
+{
+  memset(back, color, VGA_FRAME_BYTES);
+}
+
+/* function: vga_pixel
+   Description: Set one pixel; off-screen pixels are ignored. */
+void vga_pixel(int x, int y, unsigned color)
+{
+  if ((unsigned) x < VGA_WIDTH && (unsigned) y < VGA_HEIGHT)
+    back[y * VGA_WIDTH + x] = color;
+}
+
+/* function: vga_fill_rect
+   Description: Fill a w by h rectangle at x, y, clipped. */
+void vga_fill_rect(int x, int y, int w, int h, unsigned color)
+{
+  int dx, dy;
+  unsigned char *row;
+
+  if (!clip(&x, &y, &w, &h, &dx, &dy))
+    return;
+  row = back + y * VGA_WIDTH + x;
+  for (; h > 0; h--, row += VGA_WIDTH)
+    memset(row, color, w);
+}
+
+/* function: vga_line
+   Description: Draw a line between two points (Bresenham), clipped
+   pixel by pixel. Horizontal and vertical lines take the fill path. */
+void vga_line(int x0, int y0, int x1, int y1, unsigned color)
+{
+  int dx, dy, sx, sy, err;
+
+  if (y0 == y1) {
+    if (x0 > x1) {
+      int t = x0;
+      x0 = x1;
+      x1 = t;
+    }
+    vga_fill_rect(x0, y0, x1 - x0 + 1, 1, color);
+    return;
+  }
+  if (x0 == x1) {
+    if (y0 > y1) {
+      int t = y0;
+      y0 = y1;
+      y1 = t;
+    }
+    vga_fill_rect(x0, y0, 1, y1 - y0 + 1, color);
+    return;
+  }
+
+  dx = x1 > x0 ? x1 - x0 : x0 - x1;
+  dy = y1 > y0 ? y0 - y1 : y1 - y0;   /* Negative */
+  sx = x0 < x1 ? 1 : -1;
+  sy = y0 < y1 ? 1 : -1;
+  err = dx + dy;
+  while (1) {
+    int e2 = 2 * err;
+
+    vga_pixel(x0, y0, color);
+    if (x0 == x1 && y0 == y1)
+      break;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+/* function: vga_blit
+   Description: Copy a w by h sprite (w bytes per row) to x, y, clipped. */
+void vga_blit(int x, int y, int w, int h, const unsigned char *src)
+{
+  int dx, dy, stride = w;
+  unsigned char *row;
+
+  if (!clip(&x, &y, &w, &h, &dx, &dy))
+    return;
+  src += dy * stride + dx;
+  row = back + y * VGA_WIDTH + x;
+  for (; h > 0; h--, row += VGA_WIDTH, src += stride)
+    memcpy(row, src, w);
+}
+
+/* function: vga_blit_key
+   Description: Like vga_blit, but pixels equal to key are transparent. */
+void vga_blit_key(int x, int y, int w, int h, const unsigned char *src,
+                  unsigned key)
+{
+  int dx, dy, stride = w;
+  unsigned char *row;
+
+  if (!clip(&x, &y, &w, &h, &dx, &dy))
+    return;
+  src += dy * stride + dx;
+  row = back + y * VGA_WIDTH + x;
+  for (; h > 0; h--, row += VGA_WIDTH, src += stride)
+    for (int i = 0; i < w; i++)
+      if (src[i] != key)
+        row[i] = src[i];
+}
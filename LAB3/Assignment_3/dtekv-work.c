@@ -0,0 +1,173 @@
+/* dtekv-work.c
+
+   Deferred work and debouncing, so interrupt handlers never wait.
+
+   An ISR acknowledges its device and calls work_queue; the main loop
+   (or any idle point) calls work_run, which executes the queued items
+   with interrupts enabled. A debouncer replaces the delay() calls that
+   used to run inside the button and switch handlers: the PIO interrupt
+   queues the action and masks itself, and debounce_tick, called from
+   the periodic timer interrupt, re-arms it once the input has been
+   stable for settle_ticks ticks.
+
+   Handlers that only need to report what happened post a timestamped
+   event instead. The event ring has one producer side (handlers do not
+   nest) and one consumer, the main loop, so neither side masks
+   interrupts; event_drain hands the main loop a batch at a time. */
+
+#include "dtekv-lib.h"
+
+#define PIO_DATA     0
+#define PIO_IRQ_MASK 2
+#define PIO_EDGE     3
+
+static struct {
+  work_fn fn;
+  unsigned arg;
+} work_items[WORK_QUEUE_SIZE];
+static volatile unsigned work_head = 0;   /* Next free slot, producers */
+static volatile unsigned work_tail = 0;   /* Next item to run, work_run */
+static volatile unsigned work_lost = 0;
+
+/* function: work_queue
+   Description: Queue fn(arg) for the next work_run. Callable from
+   interrupt handlers and from the main loop. Returns 0, or -1 if the
+   queue was full and the item was dropped. */
+int work_queue(work_fn fn, unsigned arg)
+{
+  unsigned flags = irq_save();
+  unsigned head = work_head;
+
+  if (head - work_tail >= WORK_QUEUE_SIZE) {
+    work_lost++;
+    irq_restore(flags);
+    return -1;
+  }
+  work_items[head & (WORK_QUEUE_SIZE - 1)].fn = fn;
+  work_items[head & (WORK_QUEUE_SIZE - 1)].arg = arg;
+  work_head = head + 1;
+  irq_restore(flags);
+  return 0;
+}
+
+/* function: work_run
+   Description: Run every queued item, including ones queued while this
+   runs. Call from the main loop only. Returns how many ran. */
+unsigned work_run(void)
+{
+  unsigned ran = 0;
+
+  while (work_tail != work_head) {
+    unsigned tail = work_tail;
+    work_fn fn = work_items[tail & (WORK_QUEUE_SIZE - 1)].fn;
+    unsigned arg = work_items[tail & (WORK_QUEUE_SIZE - 1)].arg;
+    work_tail = tail + 1;
+    fn(arg);
+    ran++;
+  }
+  return ran;
+}
+
+/* Items dropped because the queue was full. */
+unsigned work_overflows(void)
+{
+  return work_lost;
+}
+
+RING_DECLARE(event_ring, struct event, EVENT_RING_SIZE)
+
+static struct event_ring events;
+
+/* function: event_post
+   Description: Queue an event stamped with the current cycle count.
+   Call from interrupt handlers only; the main loop is the consumer.
+   Returns 0, or -1 if the ring was full and the event was dropped. */
+int event_post(unsigned type, unsigned data)
+{
+  struct event e;
+
+  e.cycle = mcycle_now();
+  e.type = type;
+  e.data = data;
+  return event_ring_put(&events, &e);
+}
+
+/* function: event_drain
+   Description: Move up to max events, oldest first, into batch. Call
+   from the main loop only. Returns how many were moved. */
+unsigned event_drain(struct event *batch, unsigned max)
+{
+  return event_ring_get_batch(&events, batch, max);
+}
+
+/* Events dropped because the ring was full. */
+unsigned event_overflows(void)
+{
+  return events.lost;
+}
+
+/* function: debounce_init
+   Description: Configure the PIO block at pio for the bits in mask as
+   interrupting inputs and attach action to them. */
+void debounce_init(struct debouncer *d, volatile int *pio, unsigned mask,
+                   unsigned settle_ticks, int mode, work_fn action, unsigned arg)
+{
+  d->pio = pio;
+  d->mask = mask;
+  d->settle_ticks = settle_ticks ? settle_ticks : 1;
+  d->mode = mode;
+  d->action = action;
+  d->arg = arg;
+  d->level = pio[PIO_DATA] & mask;
+  d->count = 0;
+
+  pio[1] = 0;                    /* Direction: input */
+  pio[PIO_EDGE] = mask;          /* Clear stale edges */
+  pio[PIO_IRQ_MASK] = mask;
+}
+
+/* function: debounce_edge
+   Description: Call from the PIO's interrupt. Acknowledges the edge,
+   queues the action and masks the input until it has settled. Returns
+   1 for an accepted edge (d->level holds the input bits), 0 for a
+   bounce. */
+int debounce_edge(struct debouncer *d)
+{
+  volatile int *pio = d->pio;
+  unsigned edges = pio[PIO_EDGE];
+
+  pio[PIO_EDGE] = edges;
+  if ((edges & d->mask) == 0 || d->count != 0)
+    return 0;
+
+  pio[PIO_IRQ_MASK] = 0;
+  d->level = pio[PIO_DATA] & d->mask;
+  d->count = d->settle_ticks;
+  if (d->action)
+    work_queue(d->action, d->arg);
+  return 1;
+}
+
+/* function: debounce_tick
+   Description: Call from the periodic timer interrupt. Counts down
+   while the input is stable (and, for DEBOUNCE_PRESS, released), then
+   clears bounce edges and re-enables the input's interrupt. */
+void debounce_tick(struct debouncer *d)
+{
+  volatile int *pio = d->pio;
+  unsigned level;
+
+  if (d->count == 0)
+    return;
+
+  level = pio[PIO_DATA] & d->mask;
+  if (level != d->level || (d->mode == DEBOUNCE_PRESS && level != 0)) {
+    d->level = level;
+    d->count = d->settle_ticks;   /* Still bouncing or held: start over */
+    return;
+  }
+  if (--d->count == 0) {
+    pio[PIO_EDGE] = d->mask;
+    pio[PIO_IRQ_MASK] = d->mask;
+  }
+}
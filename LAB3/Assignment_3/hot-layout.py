@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""hot-layout.py
+
+Turn the PC samples collected by PROF_SAMPLE (dtekv-prof.c) into the
+.text order that dtekv-script.lds includes right after the trap vector.
+
+    python3 hot-layout.py layout.sym pc-profile.bin > dtekv-hot.ld
+
+layout.sym is `objdump -t main.elf <objects>`: the linked image gives
+every .text symbol its address, the objects give the input section each
+function was compiled into (one per function with -ffunction-sections).
+pc-profile.bin is prof_pc_hist read back with dtekv-download: one
+little-endian word per 2^PROF_PC_SHIFT bytes of code, from address 0.
+`make layout` runs both steps.
+
+Functions are listed hottest first until HOT_FRACTION of all samples
+is covered; everything else, and anything never sampled, keeps the
+default link order behind them. Hand-written assembly has no section
+per function, so a hot symbol from a .S file pulls in that file's
+whole .text. boot.o is always first and is left out.
+
+PROF_SAMPLE runs from the timer interrupt, so code that runs with
+interrupts masked is never sampled: the interrupt path itself and the
+soft timer callbacks. ISR_PATH lists it; those functions go first,
+ahead of the sampled ones, as in the hand-written dtekv-hot.ld.
+"""
+
+import bisect
+import re
+import struct
+import sys
+
+PC_SHIFT = 4            # PROF_PC_SHIFT in dtekv-lib.h
+HOT_FRACTION = 0.99
+
+# Runs with interrupts masked, so it never shows up in the samples
+ISR_PATH = ('handle_interrupt', 'timer_isr', 'uart_tx_isr', 'uart_tx_kick',
+            'uart_rx_isr', 'uart_poll')
+
+SYMBOL = re.compile(r'^([0-9a-f]{8}) (.{7}) (\S+)\s+([0-9a-f]{8}) (\S+)$')
+HEADER = re.compile(r'^(\S+):\s+file format')
+
+
+def read_symbols(path):
+    """Return ([(address, name)] of the image's .text symbols, sorted,
+    and {name: {(object, input section)}} from the objects."""
+    image, sections = [], {}
+    current = None
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip('\n')
+            m = HEADER.match(line)
+            if m:
+                current = m.group(1)
+                continue
+            m = SYMBOL.match(line)
+            if not m:
+                continue
+            addr, flags, section, _, name = m.groups()
+            if not section.startswith('.text') or 'd' in flags or 'f' in flags:
+                continue
+            if current.endswith('.elf'):
+                image.append((int(addr, 16), name))
+            else:
+                sections.setdefault(name, set()).add((current, section))
+    image.sort()
+    return image, sections
+
+
+def read_profile(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    return struct.unpack('<%dI' % (len(data) // 4), data[:len(data) // 4 * 4])
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: hot-layout.py layout.sym pc-profile.bin')
+    image, sections = read_symbols(sys.argv[1])
+    counts = read_profile(sys.argv[2])
+    addrs = [a for a, _ in image]
+
+    # Each bucket goes to the symbol covering its middle
+    samples = {}
+    total = 0
+    for bucket, n in enumerate(counts):
+        if n == 0:
+            continue
+        total += n
+        i = bisect.bisect_right(addrs, (bucket << PC_SHIFT) + (1 << PC_SHIFT) // 2) - 1
+        if i >= 0:
+            name = image[i][1]
+            samples[name] = samples.get(name, 0) + n
+
+    print('/* .text order generated by hot-layout.py from %d PC samples;' % total)
+    print('   regenerate with make PROF=1 run, then make layout. */')
+
+    emitted = set()
+
+    def emit(name, note):
+        for obj, section in sorted(sections.get(name, ())):
+            if section == '.text':
+                if obj == 'boot.o':
+                    continue
+                pattern = '*%s(.text)' % obj
+            else:
+                pattern = '*(%s)' % section
+            if pattern not in emitted:
+                emitted.add(pattern)
+                print('%-40s /* %s %s */' % (pattern, note, name))
+
+    for name in ISR_PATH:
+        emit(name, ' ISR  ')
+
+    covered = 0
+    for name, n in sorted(samples.items(), key=lambda s: -s[1]):
+        if total and covered >= HOT_FRACTION * total:
+            break
+        covered += n
+        emit(name, '%5.1f%%' % (100.0 * n / total))
+
+
+if __name__ == '__main__':
+    main()
@@ -6,6 +6,8 @@
 
 */
 
+#include "dtekv-lib.h"
+
 /* External function declarations - these are defined in other files */
 extern void print(const char*);
 extern void print_dec(unsigned int);
@@ -15,90 +17,135 @@ extern void tick(int*);
 extern void delay(int);
 extern int nextprime(int);
 extern void enable_interrupt(void);
+extern void uart_tx_init(int);
+extern void uart_tx_isr(void);
+extern void uart_rx_isr(void);
 
 /* Global variables */
 int mytime = 0x5957;                    // Current time in BCD format (59:57 = 59 min, 57 sec)
 int hours = 0;                          // Current hour (0-23)
-int timeout_counter = 0;                // Counts timer interrupts (0-9, each = 0.1s)
+struct clock wall_clock;                // Binary seconds since midnight; mytime/hours mirror it
 int prime = 1234567;                    // Used by main loop to calculate primes
+int clock_step = 1;                     // Seconds the clock advances each second (shell: set step)
 char textstring[] = "text, more text, and even more text!";
 
+/* Prime stream work area: two 2 KB sieve segments plus room for 1024
+   sieving primes, enough to walk primes up to about 66 million. Past
+   that the main loop steps on with nextprime. */
+#define PRIME_SEGMENT_WORDS 512
+#define PRIME_WORK_WORDS    (2 * PRIME_SEGMENT_WORDS + 2 * 1024)
+unsigned prime_work[PRIME_WORK_WORDS];
+struct prime_stream primes;
+
+/* Profiling probes (build with make PROF=1 to enable) */
+enum { PROBE_TICK, PROBE_PRIME };
+#define PROF_DUMP_INTERVAL 1000   // Print the profile every this many primes
+
 /* Hardware I/O register pointers */
 volatile int *LED_PTR       = (volatile int *) 0x04000000; // LEDs
-volatile int *DISPLAYS_PTR  = (volatile int *) 0x04000050; // 7-segment displays
 volatile int *SWITCH_PTR    = (volatile int *) 0x04000010; // Switches (data register, offset 0)
 volatile int *BUTTON_PTR    = (volatile int *) 0x040000d0; // Buttons
 
-/* Timer registers */
-volatile int *timer_status  = (volatile int *) 0x04000020; // Offset 0
-volatile int *timer_control = (volatile int *) 0x04000024; // Offset 1
-volatile int *timer_periodl = (volatile int *) 0x04000028; // Offset 2
-volatile int *timer_periodh = (volatile int *) 0x0400002C; // Offset 3
+/* Software timers on the Avalon timer, 1 ms ticks at 30 MHz */
+#define TICK_CYCLES 30000
+struct soft_timer uart_timer;           // Every 10 ms: keep the UART ring draining
+
+/* The clock runs as its own task next to the prime loop in main */
+#define CLOCK_STACK_BYTES 1024
+struct task clock_task;
 
 /* Helper function: Display a single digit (0-9) on a 7-segment display */
 void set_displays(int display_number, int value) {
-  // Each display is 16 bytes apart in memory (4 int-sized steps = 16 bytes)
-  volatile int *DISPLAY_PTR = DISPLAYS_PTR + 4 * display_number;
-  char pattern;
-
-  // Convert digit to 7-segment pattern
-  switch(value) {
-    case 0: pattern = 0b11000000; break;
-    case 1: pattern = 0b11111001; break;
-    case 2: pattern = 0b10100100; break;
-    case 3: pattern = 0b10110000; break;
-    case 4: pattern = 0b10011001; break;
-    case 5: pattern = 0b10010010; break;
-    case 6: pattern = 0b10000010; break;
-    case 7: pattern = 0b11111000; break;
-    case 8: pattern = 0b10000000; break;
-    case 9: pattern = 0b10010000; break;
-    default: pattern = 0xFF; break; // Off for invalid input
-  }
-  *DISPLAY_PTR = pattern; // Write pattern to the display
+  // Glyph table lookup; the register is only written if the digit changed
+  display_char(display_number, value >= 0 && value <= 9 ? '0' + value : ' ');
 }
 
 /* Helper function: Update all 7-segment displays to reflect current time */
 void update_displays(void) {
-  int sec_ones = (mytime >> 0) & 0xF;
-  int sec_tens = (mytime >> 4) & 0xF;
-  int min_ones = (mytime >> 8) & 0xF;
-  int min_tens = (mytime >> 12) & 0xF;
-  int hou_ones = hours % 10;
-  int hou_tens = hours / 10;
-
-  set_displays(0, sec_ones);
-  set_displays(1, sec_tens);
-  set_displays(2, min_ones);
-  set_displays(3, min_tens);
-  set_displays(4, hou_ones);
-  set_displays(5, hou_tens);
+  display_bcd(clock_bcd(&wall_clock)); // 0xHHMMSS, only changed digits are written
 }
 
 /* Helper function: Advance time by N seconds and update displays */
 void advance_time_seconds(int seconds) {
-  for (int i = 0; i < seconds; i++) {
-    tick(&mytime);
-    if (mytime == 0x10000) { // After 0x5959 it goes to 0x10000
-      mytime = 0;
-      hours++;
-      if (hours == 24) hours = 0;
-    }
-  }
+  clock_add(&wall_clock, seconds);    // One step for any amount, wraps at midnight
+  mytime = clock_bcd(&wall_clock) & 0xFFFF;
+  hours = wall_clock.seconds / 3600;
   update_displays();
 }
 
+/* Clock task: wakes once a second, on deadlines so it never drifts */
+void clock_run(unsigned arg) {
+  unsigned next = timer_now();
+  while (1) {
+    next += 1000;
+    task_sleep_until(next);
+    PROF_BEGIN(PROBE_TICK);
+    advance_time_seconds(clock_step);
+    PROF_END(PROBE_TICK);
+  }
+}
+
+/* Soft timer callback, run from timer_isr in interrupt context */
+void uart_poll(unsigned arg) {
+  uart_tx_isr(); // Keep output moving even if the UART IRQ is not wired
+  uart_rx_isr(); // Likewise for typed input
+}
+
+/* Shell command: "time" shows the clock, "time 235955" sets it */
+int cmd_time(int argc, char **argv) {
+  char buf[FMT_HEX32_SIZE];
+  int hhmmss;
+
+  if (argc > 2)
+    return -1;
+  if (argc == 2) {
+    if (shell_parse_int(argv[1], &hhmmss) < 0 || hhmmss < 0 ||
+        hhmmss / 10000 > 23 || hhmmss / 100 % 100 > 59 || hhmmss % 100 > 59)
+      return -1;                        // Not a time of day: print the usage
+    clock_set_bcd(&wall_clock, 0);
+    clock_add(&wall_clock, hhmmss / 10000 * 3600 + hhmmss / 100 % 100 * 60 + hhmmss % 100);
+    advance_time_seconds(0);            // Refresh mytime, hours and the displays
+  }
+  console_write(buf, fmt_hex32(buf, clock_bcd(&wall_clock), 6));
+  printc('\n');
+  return 0;
+}
+
+/* Shell command: peak stack use of main and the clock task */
+int cmd_stack(int argc, char **argv) {
+  task_stack_dump(task_current());
+  task_stack_dump(&clock_task);
+  return 0;
+}
+
 /* Initialize interrupts for timer */
 void labinit(void) {
-  // Configure timer for 0.1 second interrupts
-  int period = 3000000 - 1;                 // Set the timer period to 3 million cycles (0.1 sec at 30 MHz)
-  *timer_periodl = period & 0xFFFF;         // Set the lower 16 bits of the period
-  *timer_periodh = (period >> 16) & 0xFFFF; // Set the upper 16 bits of the period
-  *timer_control = 0b111;                   // START + CONTINUOUS + INTERRUPT ENABLE (bits 0, 1, 2)
+  // Hand the hardware timer to the timer wheel
+  timer_service_init(TICK_CYCLES);
+  timer_start(&uart_timer, 10, 10, uart_poll, 0);
+
+  // main becomes the first task; the clock gets a task of its own
+  task_init();
+  task_create(&clock_task, "clock", clock_run, 0, CLOCK_STACK_BYTES);
+
+  clock_set_bcd(&wall_clock, mytime);       // Start from 00:59:57
 
   // Initialize displays to show the starting time immediately
   update_displays();
 
+  prof_name(PROBE_TICK, "clock second");
+  prof_name(PROBE_PRIME, "next prime");
+
+  // Buffer UART output so printing does not stall the prime loop
+  uart_tx_init(UART_TX_BLOCK);
+
+  // Live tuning over the JTAG UART (make shell)
+  shell_init();
+  shell_var_range("prime", &prime, 0, 0x7FFFFFFF); // nextprime takes an int
+  shell_var_range("step", &clock_step, -86399, 86399); // Under a day either way
+  shell_cmd("time", cmd_time, "time [HHMMSS]");
+  shell_cmd("stack", cmd_stack, "stack");
+
   // Enable global interrupts
   enable_interrupt();
 }
@@ -107,28 +154,47 @@ void labinit(void) {
 void handle_interrupt(unsigned cause) {
 
   // ====== TIMER INTERRUPT (IRQ 16) ======
-  if (cause == 16 && (*timer_status & 1)) {
-    // Acknowledge timer interrupt by clearing the status bit
-    *timer_status = 0;
-
-    timeout_counter++; // Increment the timeout counter (0-9 for deciseconds)
+  if (cause == 16) {
+    PROF_SAMPLE(); // PC profile for make layout (PROF=1 only)
+    timer_isr(); // Acknowledges the timer and runs every soft timer due
+    return;
+  }
 
-    if (timeout_counter == 10) { // Every 1 second (10 × 0.1s)
-      timeout_counter = 0; // Reset the timeout counter
-      advance_time_seconds(1);
-    }
+  // ====== JTAG UART INTERRUPT ======
+  if (cause == JTAG_UART_IRQ) {
+    uart_rx_isr(); // Move typed characters into the receive ring
+    uart_tx_isr(); // Refill the transmit FIFO from the ring buffer
     return;
   }
 }
 
 /* Main program */
 int main(void) {
+  int shown; // Last prime printed; differs from prime after "set prime"
+  int next;
+
   labinit(); // Initialize everything ONCE at startup
 
-  while (1) {  // Loop forever
+  // Walk consecutive primes with the segmented sieve instead of nextprime
+  prime_stream_init(&primes, prime, prime_work, PRIME_WORK_WORDS, PRIME_SEGMENT_WORDS);
+
+  for (int n = 1; ; n++) {  // Loop forever
     print("Prime: ");
-    prime = nextprime(prime);
+    PROF_BEGIN(PROBE_PRIME);
+    next = prime_stream_next(&primes);
+    if (next == 0) // Past what prime_work can sieve: one at a time, as before
+      next = nextprime(prime);
+    prime = shown = next;
+    PROF_END(PROBE_PRIME);
     print_dec(prime);
     print("\n");
+
+    work_run(); // Run whatever the interrupt handlers deferred
+    if (shell_poll() && prime != shown) // "set prime N" restarts the walk from N
+      prime_stream_init(&primes, prime, prime_work, PRIME_WORK_WORDS, PRIME_SEGMENT_WORDS);
+    task_yield(); // Let the clock task in if its second is up
+
+    if (PROF_ENABLE && n % PROF_DUMP_INTERVAL == 0)
+      prof_dump();
   }
 }
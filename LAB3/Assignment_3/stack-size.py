@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+"""stack-size.py
+
+Read back the boot stack painted by _start (boot.S) and suggest a
+__stack_size for dtekv-script.lds.
+
+    python3 stack-size.py stack.bin
+
+stack.bin is the whole .stack region, _stack_begin to _stack_end, read
+with dtekv-download after the program has run through its deepest
+paths; `make stack` does both steps. The peak is everything above the
+lowest word that no longer holds STACK_PAINT. The suggestion adds
+MARGIN of the peak plus one full trap frame, in case the deepest call
+was not interrupted during the run, and rounds up to ROUND bytes. Link
+with it using `make STACK_SIZE=0x...`.
+"""
+
+import struct
+import sys
+
+STACK_PAINT = 0xDEADBEEF    # STACK_PAINT in dtekv-lib.h
+TRAP_FRAME = 144            # _isr_routine's frame
+MARGIN = 0.25
+ROUND = 1024
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('usage: stack-size.py stack.bin')
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+    words = struct.unpack('<%dI' % (len(data) // 4), data[:len(data) // 4 * 4])
+    size = len(words) * 4
+    if not words:
+        sys.exit('stack-size.py: empty stack image')
+
+    lowest = next((i for i, w in enumerate(words) if w != STACK_PAINT), len(words))
+    peak = size - lowest * 4
+    if lowest == 0:
+        print('stack overflowed or was never painted: all %d bytes written' % size)
+        print('raise __stack_size (make STACK_SIZE=0x...) and measure again')
+        return
+
+    suggest = int(peak * (1 + MARGIN)) + TRAP_FRAME
+    suggest = (suggest + ROUND - 1) // ROUND * ROUND
+    print('stack peak %d of %d bytes (%.1f%%)' % (peak, size, 100.0 * peak / size))
+    print('suggested __stack_size: 0x%x (%d bytes, %d freed)'
+          % (suggest, suggest, max(size - suggest, 0)))
+    print('link with: make STACK_SIZE=0x%x' % suggest)
+
+
+if __name__ == '__main__':
+    main()
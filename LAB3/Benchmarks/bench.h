@@ -0,0 +1,36 @@
+/* bench.h
+
+   Shared helpers for the firmware benchmarks. */
+
+#define BENCH_CLOCK_HZ 30000000   /* DTEK-V core clock assumed by labinit */
+
+extern void enable_interrupt(void);
+
+/* Read the low word of the cycle counter. */
+static inline unsigned bench_cycles(void)
+{
+  unsigned c;
+  asm volatile ("csrr %0, mcycle" : "=r"(c));
+  return c;
+}
+
+/* Print "name: value unit" on its own line. */
+static inline void bench_report(const char *name, unsigned value, const char *unit)
+{
+  print(name);
+  print(": ");
+  print_dec(value);
+  printc(' ');
+  print(unit);
+  printc('\n');
+}
+
+/* Events per second for count events observed over cycles clock cycles,
+   without 64-bit division (there is no libgcc). */
+static inline unsigned bench_per_second(unsigned count, unsigned cycles)
+{
+  unsigned ms = cycles / (BENCH_CLOCK_HZ / 1000);
+  if (ms == 0)
+    ms = 1;
+  return count / ms * 1000 + (count % ms) * 1000 / ms;
+}
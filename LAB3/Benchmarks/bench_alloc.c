@@ -0,0 +1,66 @@
+/* bench_alloc.c
+
+   Allocation cycles: arena_alloc, a pool_alloc/pool_free pair, and
+   heap_alloc/heap_free with mixed request sizes, then the heap
+   statistics from heap_dump. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define ROUNDS 1000
+#define LIVE   32
+
+static void *live[LIVE];
+static unsigned seed = 1;
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+static unsigned rnd(unsigned n)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) % n;
+}
+
+int main(void)
+{
+  struct arena *a;
+  struct pool objects;
+  unsigned t, mark;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== Allocators ====\n");
+  if (heap_init(LIVE)) {
+    print("heap too small\n");
+    while (1);
+  }
+  a = heap_arena();
+
+  mark = arena_mark(a);
+  t = bench_cycles();
+  for (int i = 0; i < ROUNDS; i++)
+    arena_alloc(a, 24);
+  bench_report("arena_alloc", (bench_cycles() - t) / ROUNDS, "cycles");
+  t = bench_cycles();
+  arena_reset(a, mark);
+  bench_report("arena_reset", bench_cycles() - t, "cycles");
+
+  pool_init(&objects, a, 48, LIVE);
+  t = bench_cycles();
+  for (int i = 0; i < ROUNDS; i++)
+    pool_free(&objects, pool_alloc(&objects));
+  bench_report("pool_alloc + pool_free", (bench_cycles() - t) / ROUNDS, "cycles");
+
+  /* Random sizes with up to LIVE blocks held at once */
+  t = bench_cycles();
+  for (int i = 0; i < ROUNDS; i++) {
+    int k = rnd(LIVE);
+    heap_free(live[k]);
+    live[k] = heap_alloc(1 + rnd(200));
+  }
+  bench_report("heap_free + heap_alloc", (bench_cycles() - t) / ROUNDS, "cycles");
+
+  heap_dump();
+  while (1);
+}
@@ -0,0 +1,73 @@
+/* bench_clock.c
+
+   Cycles to move the clock forward by N seconds: the labs' loop of
+   tick() calls on the BCD mytime (with the 0x10000 carry into hours)
+   against one clock_add plus the BCD conversion for the display, and
+   the cost of clock_bcd when its cache hits. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+extern void tick(int *);
+
+static const int amounts[] = { 1, 60, 3600, 86399 };
+#define AMOUNTS (sizeof(amounts) / sizeof(amounts[0]))
+
+static struct clock wall;
+volatile unsigned sink;
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+/* advance_time_seconds as the lab programs had it */
+static void tick_loop(int seconds, int *mytime, int *hours)
+{
+  for (int i = 0; i < seconds; i++) {
+    tick(mytime);
+    if (*mytime == 0x10000) {
+      *mytime = 0;
+      if (++*hours == 24)
+        *hours = 0;
+    }
+  }
+}
+
+int main(void)
+{
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== Clock arithmetic ====\n");
+
+  for (int i = 0; i < AMOUNTS; i++) {
+    int mytime = 0x5957, hours = 0;
+    unsigned t;
+
+    print("+");
+    print_dec(amounts[i]);
+    print(" s\n");
+
+    t = bench_cycles();
+    tick_loop(amounts[i], &mytime, &hours);
+    bench_report("  tick loop", bench_cycles() - t, "cycles");
+
+    clock_set_bcd(&wall, 0x005957);
+    t = bench_cycles();
+    clock_add(&wall, amounts[i]);
+    sink = clock_bcd(&wall);
+    bench_report("  clock_add + clock_bcd", bench_cycles() - t, "cycles");
+
+    if ((sink & 0xFFFF) != mytime || (sink >> 16) != (hours / 10 << 4 | hours % 10))
+      print("  mismatch\n");
+  }
+
+  {
+    unsigned t = bench_cycles();
+    sink = clock_bcd(&wall);
+    bench_report("clock_bcd, cached", bench_cycles() - t, "cycles");
+    t = bench_cycles();
+    clock_add(&wall, -1);
+    bench_report("clock_add(-1)", bench_cycles() - t, "cycles");
+  }
+
+  while (1);
+}
@@ -0,0 +1,52 @@
+/* bench_console.c
+
+   Characters per second through print with each output sink: the JTAG
+   UART (unbuffered), the VGA text console, and both. The VGA run
+   scrolls the screen many times over; its result is read on the
+   screen, the others over the UART. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define LINES 300
+
+static const char line[] = "The quick brown fox jumps over 13 dogs\n";
+#define LINE_CHARS (sizeof(line) - 1)
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+static unsigned run(int sinks)
+{
+  unsigned t;
+
+  console_sink(sinks);
+  t = bench_cycles();
+  for (int i = 0; i < LINES; i++)
+    print(line);
+  if (sinks & CONSOLE_VGA)
+    vgacon_flush();
+  t = bench_cycles() - t;
+  console_sink(CONSOLE_UART);
+  return bench_per_second(LINES * LINE_CHARS, t);
+}
+
+int main(void)
+{
+  unsigned uart, vga, both;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  vgacon_init(VGA_RGB(255, 255, 255), VGA_RGB(0, 0, 128));
+
+  uart = run(CONSOLE_UART);
+  vga = run(CONSOLE_VGA);
+  both = run(CONSOLE_BOTH);
+
+  console_sink(CONSOLE_BOTH);
+  print("\n==== Console sinks ====\n");
+  bench_report("UART", uart, "chars/s");
+  bench_report("VGA", vga, "chars/s");
+  bench_report("UART + VGA", both, "chars/s");
+  while (1);
+}
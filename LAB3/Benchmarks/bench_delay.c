@@ -0,0 +1,115 @@
+/* bench_delay.c
+
+   Accuracy of waits against the 30 MHz clock labinit assumes. First
+   mcycle is checked against the Avalon timer over one second, then the
+   old calibrated delay loop, the spinning delay_us/delay_ms and the
+   wfi path (timer service running) are timed with mcycle and their
+   error printed in cycles and parts per million. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define TIMER ((volatile int *) 0x04000020)
+#define TICK  30000                 /* Timer service tick (1 ms) */
+#define CYCLES_PER_MS (BENCH_CLOCK_HZ / 1000)
+
+static const unsigned lengths_ms[] = { 1, 10, 100 };
+#define LENGTHS (sizeof(lengths_ms) / sizeof(lengths_ms[0]))
+
+void handle_interrupt(unsigned cause)
+{
+  if (cause == 16)
+    timer_isr();
+}
+
+/* The busy loop timetemplate.S used before: ms * 10000 iterations. */
+static void old_delay(int ms)
+{
+  asm volatile ("1: li t0, 0\n"
+                "   li t1, 10000\n"
+                "2: bge t0, t1, 3f\n"
+                "   addi t0, t0, 1\n"
+                "   j 2b\n"
+                "3: addi %0, %0, -1\n"
+                "   bgt %0, x0, 1b"
+                : "+r"(ms) :: "t0", "t1");
+}
+
+static unsigned timer_snapshot(void)
+{
+  TIMER[4] = 0;
+  return (TIMER[4] & 0xFFFF) | (TIMER[5] << 16);
+}
+
+/* Print "name: +N cycles" for a wait of expected cycles, and the error
+   in parts per million for waits of a millisecond or more. */
+static void report_error(const char *name, unsigned expected, unsigned actual)
+{
+  char sign = actual >= expected ? '+' : '-';
+  unsigned diff = actual >= expected ? actual - expected : expected - actual;
+
+  print(name);
+  print(": ");
+  printc(sign);
+  print_dec(diff);
+  print(" cycles");
+  if (expected >= CYCLES_PER_MS) {
+    print(", ");
+    printc(sign);
+    print_dec(diff * 1000 / (expected / 1000));
+    print(" ppm");
+  }
+  printc('\n');
+}
+
+static void time_waits(const char *label, void (*wait)(unsigned))
+{
+  for (int i = 0; i < LENGTHS; i++) {
+    unsigned t = bench_cycles();
+    wait(lengths_ms[i]);
+    t = bench_cycles() - t;
+    print(label);
+    print_dec(lengths_ms[i]);
+    report_error(" ms", lengths_ms[i] * CYCLES_PER_MS, t);
+  }
+}
+
+static void wait_old(unsigned ms)      { old_delay(ms); }
+static void wait_ms(unsigned ms)       { delay_ms(ms); }
+static void wait_us(unsigned ms)       { delay_us(ms * 1000); }
+
+int main(void)
+{
+  unsigned s0, s1, t;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== Delay accuracy against 30 MHz ====\n");
+
+  /* mcycle against the free-running Avalon timer over one second */
+  TIMER[1] = 0x8;                       /* STOP */
+  TIMER[2] = 0xFFFF;
+  TIMER[3] = 0xFFFF;
+  TIMER[1] = 0x6;                       /* CONT | START, no interrupt */
+  s0 = timer_snapshot();
+  t = bench_cycles();
+  while (bench_cycles() - t < BENCH_CLOCK_HZ)
+    ;
+  s1 = timer_snapshot();
+  TIMER[1] = 0x8;
+  report_error("Avalon timer over 1 s of mcycle", BENCH_CLOCK_HZ, s0 - s1);
+
+  time_waits("old delay loop ", wait_old);
+  time_waits("delay_ms spin ", wait_ms);
+  time_waits("delay_us spin ", wait_us);
+
+  t = bench_cycles();
+  delay_us(1);
+  report_error("delay_us(1) spin", DELAY_CYCLES_PER_US, bench_cycles() - t);
+
+  timer_service_init(TICK);
+  enable_interrupt();
+  time_waits("delay_ms wfi ", wait_ms);
+  time_waits("delay_us wfi ", wait_us);
+
+  while (1);
+}
@@ -0,0 +1,95 @@
+/* bench_display.c
+
+   MMIO writes and cycles for an hour of once-a-second clock updates:
+   the labs' old update_displays (switch per digit, all six registers
+   every time) against display_bcd with its shadow registers. Also the
+   cost of scrolling text one step at a time. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define SECONDS 3600
+
+static volatile int *DISPLAYS_PTR = (volatile int *) 0x04000050;
+static struct clock wall;
+static struct display_scroll scroller;
+static unsigned old_writes;
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+/* set_displays/update_displays as the lab programs had them */
+static void old_set_displays(int display_number, int value)
+{
+  volatile int *DISPLAY_PTR = DISPLAYS_PTR + 4 * display_number;
+  char pattern;
+
+  switch (value) {
+    case 0: pattern = 0b11000000; break;
+    case 1: pattern = 0b11111001; break;
+    case 2: pattern = 0b10100100; break;
+    case 3: pattern = 0b10110000; break;
+    case 4: pattern = 0b10011001; break;
+    case 5: pattern = 0b10010010; break;
+    case 6: pattern = 0b10000010; break;
+    case 7: pattern = 0b11111000; break;
+    case 8: pattern = 0b10000000; break;
+    case 9: pattern = 0b10010000; break;
+    default: pattern = 0xFF; break;
+  }
+  *DISPLAY_PTR = pattern;
+  old_writes++;
+}
+
+static void old_update_displays(unsigned mytime, int hours)
+{
+  old_set_displays(0, (mytime >> 0) & 0xF);
+  old_set_displays(1, (mytime >> 4) & 0xF);
+  old_set_displays(2, (mytime >> 8) & 0xF);
+  old_set_displays(3, (mytime >> 12) & 0xF);
+  old_set_displays(4, hours % 10);
+  old_set_displays(5, hours / 10);
+}
+
+int main(void)
+{
+  unsigned t, w;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== 7-segment display updates, one hour of seconds ====\n");
+
+  clock_set_bcd(&wall, 0x005957);
+  t = bench_cycles();
+  for (int i = 0; i < SECONDS; i++) {
+    clock_add(&wall, 1);
+    old_update_displays(clock_bcd(&wall) & 0xFFFF, wall.seconds / 3600);
+  }
+  t = bench_cycles() - t;
+  bench_report("old update_displays writes", old_writes, "");
+  bench_report("old update_displays", t / SECONDS, "cycles/update");
+
+  clock_set_bcd(&wall, 0x005957);
+  display_invalidate();
+  w = display_writes();
+  t = bench_cycles();
+  for (int i = 0; i < SECONDS; i++) {
+    clock_add(&wall, 1);
+    display_bcd(clock_bcd(&wall));
+  }
+  t = bench_cycles() - t;
+  bench_report("display_bcd writes", display_writes() - w, "");
+  bench_report("display_bcd", t / SECONDS, "cycles/update");
+
+  display_scroll_init(&scroller, "hello dtek-v");
+  w = display_writes();
+  t = bench_cycles();
+  for (int i = 0; i < 18; i++)
+    display_scroll_step(&scroller);
+  t = bench_cycles() - t;
+  bench_report("scroll step writes", (display_writes() - w) / 18, "avg");
+  bench_report("scroll step", t / 18, "cycles");
+
+  display_text("done");
+  while (1);
+}
@@ -0,0 +1,134 @@
+/* bench_emulate.c
+
+   What trap-and-emulate costs next to the native instruction. The
+   DTEK-V core has the M extension, so its mul and div never trap here;
+   their emulation is timed by handing trap_emulate the encoded
+   instruction and a register frame, as _isr_routine would. A
+   misaligned lw is executed for real: if the core traps on it, the
+   time includes the whole trap round trip and the per-opcode counters
+   show it. If the counter stays at zero, the core handled the access
+   in hardware. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define N 256
+
+/* R-type M instruction: rd = x10, rs1 = x11, rs2 = x12 */
+#define M_INSN(funct3) (0x01u << 25 | 12 << 20 | 11 << 15 | (funct3) << 12 | 10 << 7 | 0x33)
+
+static unsigned regs[31];
+static unsigned operand_a[N], operand_b[N];
+static unsigned char bytes[64];
+static unsigned seed = 12345;
+
+static const char *const names[8] = {
+  "mul", "mulh", "mulhsu", "mulhu", "div", "divu", "rem", "remu"
+};
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+static unsigned rnd(void)
+{
+  seed = seed * 1664525 + 1013904223;
+  return seed;
+}
+
+/* The instruction itself. The switch around it adds a few cycles to
+   the native figures. */
+static inline unsigned hw_op(unsigned funct3, unsigned a, unsigned b)
+{
+  unsigned r;
+
+  switch (funct3) {
+  case EMU_MUL:    asm volatile ("mul %0, %1, %2"      : "=r"(r) : "r"(a), "r"(b)); break;
+  case EMU_MULH:   asm volatile ("mulh %0, %1, %2"     : "=r"(r) : "r"(a), "r"(b)); break;
+  case EMU_MULHSU: asm volatile ("mulhsu %0, %1, %2"   : "=r"(r) : "r"(a), "r"(b)); break;
+  case EMU_MULHU:  asm volatile ("mulhu %0, %1, %2"    : "=r"(r) : "r"(a), "r"(b)); break;
+  case EMU_DIV:    asm volatile ("div %0, %1, %2"      : "=r"(r) : "r"(a), "r"(b)); break;
+  case EMU_DIVU:   asm volatile ("divu %0, %1, %2"     : "=r"(r) : "r"(a), "r"(b)); break;
+  case EMU_REM:    asm volatile ("rem %0, %1, %2"      : "=r"(r) : "r"(a), "r"(b)); break;
+  default:         asm volatile ("remu %0, %1, %2"     : "=r"(r) : "r"(a), "r"(b)); break;
+  }
+  return r;
+}
+
+static unsigned native(unsigned funct3)
+{
+  unsigned t = bench_cycles(), sink = 0;
+
+  for (int i = 0; i < N; i++)
+    sink += hw_op(funct3, operand_a[i], operand_b[i]);
+  t = bench_cycles() - t;
+  return sink == 1 ? t + 1 : t;             /* Keep the results live */
+}
+
+static unsigned emulated(unsigned funct3, unsigned *mismatches)
+{
+  unsigned insn = M_INSN(funct3), t = 0;
+
+  for (int i = 0; i < N; i++) {
+    unsigned t0;
+    regs[10] = operand_a[i];                /* x11 */
+    regs[11] = operand_b[i];                /* x12 */
+    t0 = bench_cycles();
+    trap_emulate(insn, regs);
+    t += bench_cycles() - t0;
+    if (regs[9] != hw_op(funct3, operand_a[i], operand_b[i]))   /* x10 */
+      (*mismatches)++;
+  }
+  return t;
+}
+
+int main(void)
+{
+  const struct emu_stat *stats = trap_emulate_stats();
+  unsigned t, v = 0, mismatches = 0;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== Trap-and-emulate ====\n");
+
+  /* Random operands, a few of them the division corner cases */
+  for (int i = 0; i < N; i++) {
+    operand_a[i] = rnd();
+    operand_b[i] = rnd() >> (rnd() & 31);
+  }
+  operand_b[0] = 0;
+  operand_a[1] = 0x80000000u;
+  operand_b[1] = ~0u;
+
+  for (unsigned f = 0; f < 8; f++) {
+    unsigned tn = native(f), te = emulated(f, &mismatches);
+    print(names[f]);
+    print(": native ");
+    print_dec(tn / N);
+    print(", emulated ");
+    print_dec(te / N);
+    print(" cycles (plus the trap)\n");
+  }
+  bench_report("results differing from the hardware", mismatches, "");
+
+  /* A real misaligned load, through the trap if the core raises one */
+  for (int i = 0; i < 64; i++)
+    bytes[i] = i;
+  trap_emulate_reset();
+  t = bench_cycles();
+  for (int i = 0; i < N; i++) {
+    unsigned r;
+    asm volatile ("lw %0, 0(%1)" : "=r"(r) : "r"(bytes + 1 + (i & 31)));
+    v += r;
+  }
+  t = bench_cycles() - t;
+  if (stats[EMU_LOAD].count == 0) {
+    bench_report("misaligned lw, in hardware", t / N, "cycles");
+  } else {
+    bench_report("misaligned lw, trap round trip", t / N, "cycles");
+    trap_emulate_dump();
+  }
+  if (v == 0)
+    print("(no data)\n");
+
+  while (1);
+}
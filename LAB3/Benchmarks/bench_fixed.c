@@ -0,0 +1,236 @@
+/* bench_fixed.c
+
+   The fixed-point library against the same operations in float, which
+   compile to calls into softfloat.a. Both sides start from identical
+   operands (every Q16.16 input below is exact as a float) and are
+   checked against a double reference, also through softfloat.a. There
+   is no libm, so the float sqrt and sin are what a lab program would
+   write: Newton steps from a bit-trick guess, and a range-reduced odd
+   polynomial. Cycles are per operation, errors the largest absolute
+   difference from the reference in units of 1e-9. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define N 256
+
+static q16 qa[N], qb[N], qr[N];
+static float fa[N], fb[N], fr[N];
+static unsigned seed = 12345;
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+static unsigned rnd(void)
+{
+  seed = seed * 1664525 + 1013904223;
+  return seed;
+}
+
+/* Operands in [lo, hi) as Q16.16, with the float copies; exact while
+   below 256 in magnitude (24 significant bits). */
+static void operands(q16 *q, float *f, int lo, int hi)
+{
+  for (int i = 0; i < N; i++) {
+    q[i] = lo + (int) (rnd() % (unsigned) (hi - lo));
+    f[i] = q[i] / 65536.0f;
+  }
+}
+
+static float f_sqrt(float x)
+{
+  union { float f; unsigned u; } v = { x };
+  float y;
+
+  if (x <= 0)
+    return 0;
+  v.u = 0x1FBD1DF5 + (v.u >> 1);
+  y = v.f;
+  for (int i = 0; i < 3; i++)
+    y = 0.5f * (y + x / y);
+  return y;
+}
+
+static double d_sqrt(double x)
+{
+  double y = f_sqrt(x);
+
+  for (int i = 0; i < 3; i++)
+    y = 0.5 * (y + x / y);
+  return y;
+}
+
+static float f_sin(float x)
+{
+  const float pi = 3.14159265f, half_pi = 1.57079633f;
+  float k = x * (1 / (2 * pi)), x2;
+
+  x -= (int) (k + (k < 0 ? -0.5f : 0.5f)) * (2 * pi);
+  if (x > half_pi)
+    x = pi - x;
+  else if (x < -half_pi)
+    x = -pi - x;
+  x2 = x * x;
+  return x * (1 + x2 * (-1 / 6.0f + x2 * (1 / 120.0f + x2 * (-1 / 5040.0f
+         + x2 * (1 / 362880.0f - x2 / 39916800.0f)))));
+}
+
+static double d_sin(double x)
+{
+  const double pi = 3.14159265358979324, half_pi = pi / 2;
+  double k = x / (2 * pi), x2, s = 0;
+
+  x -= (int) (k + (k < 0 ? -0.5 : 0.5)) * (2 * pi);
+  if (x > half_pi)
+    x = pi - x;
+  else if (x < -half_pi)
+    x = -pi - x;
+  x2 = x * x;
+  for (int n = 19; n > 1; n -= 2)   /* Horner on the Taylor series */
+    s = (1 - s) * x2 / (n * (n - 1));
+  return x * (1 - s);
+}
+
+static unsigned nano(double err)
+{
+  if (err < 0)
+    err = -err;
+  return err > 4.0 ? ~0u : (unsigned) (err * 1e9 + 0.5);
+}
+
+static unsigned fixed_err, soft_err;
+
+/* Track the error of result i against ref, fixed in Q16.16. */
+static void check(int i, double ref)
+{
+  unsigned e = nano(qr[i] / 65536.0 - ref);
+  if (e > fixed_err)
+    fixed_err = e;
+  e = nano(fr[i] - ref);
+  if (e > soft_err)
+    soft_err = e;
+}
+
+static void report(const char *name, unsigned fixed, unsigned soft)
+{
+  print(name);
+  print(": fixed ");
+  print_dec(fixed / N);
+  print(" cycles, softfloat ");
+  print_dec(soft / N);
+  print(" cycles (");
+  print_dec(fixed ? soft / fixed : 0);
+  print("x); max error fixed ");
+  print_dec(fixed_err);
+  print("e-9, softfloat ");
+  print_dec(soft_err);
+  print("e-9\n");
+  fixed_err = soft_err = 0;
+}
+
+int main(void)
+{
+  unsigned tq, tf;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== Fixed point against softfloat.a ====\n");
+
+  operands(qa, fa, Q16(-100), Q16(100));
+  operands(qb, fb, Q16(-100), Q16(100));
+  tq = bench_cycles();
+  for (int i = 0; i < N; i++)
+    qr[i] = q16_add(qa[i], qb[i]);
+  tq = bench_cycles() - tq;
+  tf = bench_cycles();
+  for (int i = 0; i < N; i++)
+    fr[i] = fa[i] + fb[i];
+  tf = bench_cycles() - tf;
+  for (int i = 0; i < N; i++)
+    check(i, (double) fa[i] + fb[i]);
+  report("q16 add", tq, tf);
+
+  tq = bench_cycles();
+  for (int i = 0; i < N; i++)
+    qr[i] = q16_mul(qa[i], qb[i]);
+  tq = bench_cycles() - tq;
+  tf = bench_cycles();
+  for (int i = 0; i < N; i++)
+    fr[i] = fa[i] * fb[i];
+  tf = bench_cycles() - tf;
+  for (int i = 0; i < N; i++)
+    check(i, (double) fa[i] * fb[i]);
+  report("q16 mul", tq, tf);
+
+  /* Divisors at least 0.5 in magnitude keep quotients in range */
+  for (int i = 0; i < N; i++)
+    if (qb[i] > Q16(-0.5) && qb[i] < Q16(0.5)) {
+      qb[i] += qb[i] < 0 ? Q16(-0.5) : Q16(0.5);
+      fb[i] = qb[i] / 65536.0f;
+    }
+  tq = bench_cycles();
+  for (int i = 0; i < N; i++)
+    qr[i] = q16_div(qa[i], qb[i]);
+  tq = bench_cycles() - tq;
+  tf = bench_cycles();
+  for (int i = 0; i < N; i++)
+    fr[i] = fa[i] / fb[i];
+  tf = bench_cycles() - tf;
+  for (int i = 0; i < N; i++)
+    check(i, (double) fa[i] / fb[i]);
+  report("q16 div", tq, tf);
+
+  operands(qa, fa, 0, Q16(250));
+  tq = bench_cycles();
+  for (int i = 0; i < N; i++)
+    qr[i] = q16_sqrt(qa[i]);
+  tq = bench_cycles() - tq;
+  tf = bench_cycles();
+  for (int i = 0; i < N; i++)
+    fr[i] = f_sqrt(fa[i]);
+  tf = bench_cycles() - tf;
+  for (int i = 0; i < N; i++)
+    check(i, d_sqrt(fa[i]));
+  report("q16 sqrt", tq, tf);
+
+  operands(qa, fa, Q16(-8), Q16(8));
+  tq = bench_cycles();
+  for (int i = 0; i < N; i++)
+    qr[i] = q16_sin(qa[i]);
+  tq = bench_cycles() - tq;
+  tf = bench_cycles();
+  for (int i = 0; i < N; i++)
+    fr[i] = f_sin(fa[i]);
+  tf = bench_cycles() - tf;
+  for (int i = 0; i < N; i++)
+    check(i, d_sin(fa[i]));
+  report("q16 sin", tq, tf);
+
+  /* Q1.31 operands use all 31 fraction bits, more than a float holds */
+  for (int i = 0; i < N; i++) {
+    qa[i] = rnd();
+    qb[i] = rnd();
+    fa[i] = qa[i] / 2147483648.0f;
+    fb[i] = qb[i] / 2147483648.0f;
+  }
+  tq = bench_cycles();
+  for (int i = 0; i < N; i++)
+    qr[i] = q31_mul(qa[i], qb[i]);
+  tq = bench_cycles() - tq;
+  tf = bench_cycles();
+  for (int i = 0; i < N; i++)
+    fr[i] = fa[i] * fb[i];
+  tf = bench_cycles() - tf;
+  for (int i = 0; i < N; i++) {
+    double ref = qa[i] / 2147483648.0 * (qb[i] / 2147483648.0);
+    unsigned e = nano(qr[i] / 2147483648.0 - ref);
+    if (e > fixed_err)
+      fixed_err = e;
+    e = nano(fr[i] - ref);
+    if (e > soft_err)
+      soft_err = e;
+  }
+  report("q31 mul", tq, tf);
+
+  while (1);
+}
@@ -0,0 +1,128 @@
+/* bench_format.c
+
+   Cycle counts for the fmt_* number formatting against the digit loops
+   that print_dec and print_hex32 used before, both writing into a
+   buffer so the UART does not dominate. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define VALUES 1024
+
+static unsigned values[VALUES];
+static char out[FMT_U64_SIZE];
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+/* The original print_dec digit loop, writing into buf. */
+static __attribute__((noinline)) int legacy_dec(char *buf, unsigned int x)
+{
+  unsigned divident = 1000000000;
+  char first = 0;
+  int len = 0;
+  do {
+    int dv = x / divident;
+    if (dv != 0) first = 1;
+    if (first != 0)
+      buf[len++] = 48 + dv;
+    x -= dv*divident;
+    divident /= 10;
+  } while (divident != 0);
+  if (first == 0)
+    buf[len++] = 48;
+  buf[len] = '\0';
+  return len;
+}
+
+/* The original print_hex32 digit loop, writing into buf. */
+static __attribute__((noinline)) int legacy_hex(char *buf, unsigned int x)
+{
+  int len = 0;
+  buf[len++] = '0';
+  buf[len++] = 'x';
+  for (int i = 7; i >= 0; i--) {
+    char hd = (char) ((x >> (i*4)) & 0xf);
+    if (hd < 10)
+      hd += '0';
+    else
+      hd += ('A' - 10);
+    buf[len++] = hd;
+  }
+  buf[len] = '\0';
+  return len;
+}
+
+static __attribute__((noinline)) int new_hex(char *buf, unsigned int x)
+{
+  buf[0] = '0';
+  buf[1] = 'x';
+  return 2 + fmt_hex32(buf + 2, x, 8);
+}
+
+/* Spread the values over every decimal length. */
+static void fill_values(void)
+{
+  unsigned x = 12345;
+  for (int i = 0; i < VALUES; i++) {
+    x = x * 1664525 + 1013904223;
+    values[i] = x >> (i & 31);
+  }
+}
+
+static void report(const char *name, unsigned cycles)
+{
+  bench_report(name, cycles / VALUES, "cycles/value");
+}
+
+int main(void)
+{
+  unsigned t0;
+
+  fill_values();
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== Number formatting ====\n");
+
+  t0 = bench_cycles();
+  for (int i = 0; i < VALUES; i++)
+    legacy_dec(out, values[i]);
+  report("print_dec loop", bench_cycles() - t0);
+
+  t0 = bench_cycles();
+  for (int i = 0; i < VALUES; i++)
+    fmt_u32(out, values[i]);
+  report("fmt_u32", bench_cycles() - t0);
+
+  t0 = bench_cycles();
+  for (int i = 0; i < VALUES; i++)
+    fmt_i32(out, (int) values[i]);
+  report("fmt_i32", bench_cycles() - t0);
+
+  t0 = bench_cycles();
+  for (int i = 0; i < VALUES; i++)
+    fmt_u32_pad(out, values[i], 12, ' ');
+  report("fmt_u32_pad", bench_cycles() - t0);
+
+  t0 = bench_cycles();
+  for (int i = 0; i < VALUES; i++)
+    fmt_u64(out, (unsigned long long) values[i] * values[VALUES - 1 - i]);
+  report("fmt_u64", bench_cycles() - t0);
+
+  t0 = bench_cycles();
+  for (int i = 0; i < VALUES; i++)
+    legacy_hex(out, values[i]);
+  report("print_hex32 loop", bench_cycles() - t0);
+
+  t0 = bench_cycles();
+  for (int i = 0; i < VALUES; i++)
+    new_hex(out, values[i]);
+  report("fmt_hex32", bench_cycles() - t0);
+
+  t0 = bench_cycles();
+  for (int i = 0; i < VALUES; i++)
+    fmt_hex64(out, (unsigned long long) values[i] << 20, 0);
+  report("fmt_hex64", bench_cycles() - t0);
+
+  while (1);
+}
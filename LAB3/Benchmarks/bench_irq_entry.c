@@ -0,0 +1,73 @@
+/* bench_irq_entry.c
+
+   Timer interrupt entry-to-handler cycles with the direct mtvec (full
+   31-register frame and the mcause compare chain) against the vectored
+   table (lean caller-saved entry). The main loop keeps stamping mcycle;
+   the handler's first action subtracts the last stamp. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define SAMPLES 1000
+#define PERIOD  3000   /* Timer period in cycles (100 us) */
+
+extern char _isr_handler[], _vector_table[];
+
+volatile int *timer_status  = (volatile int *) 0x04000020;
+volatile int *timer_control = (volatile int *) 0x04000024;
+volatile int *timer_periodl = (volatile int *) 0x04000028;
+volatile int *timer_periodh = (volatile int *) 0x0400002C;
+
+volatile unsigned stamp;
+volatile unsigned samples;
+unsigned lat_min, lat_max, lat_total;
+
+void handle_interrupt(unsigned cause)
+{
+  unsigned lat = bench_cycles() - stamp;
+
+  if (cause != 16)
+    return;
+  *timer_status = 0;
+  if (samples < SAMPLES) {
+    if (lat < lat_min)
+      lat_min = lat;
+    if (lat > lat_max)
+      lat_max = lat;
+    lat_total += lat;
+    samples++;
+  }
+}
+
+static void run(const char *name, unsigned mtvec)
+{
+  asm volatile ("csrw mtvec, %0" :: "r"(mtvec));
+  lat_min = ~0u;
+  lat_max = 0;
+  lat_total = 0;
+  samples = 0;
+
+  *timer_periodl = (PERIOD - 1) & 0xFFFF;
+  *timer_periodh = ((PERIOD - 1) >> 16) & 0xFFFF;
+  *timer_control = 0b111;
+  while (samples < SAMPLES)
+    stamp = bench_cycles();
+  *timer_control = 0b1000;   /* STOP */
+  *timer_status = 0;
+
+  print(name);
+  print("\n");
+  bench_report("  min", lat_min, "cycles");
+  bench_report("  avg", lat_total / SAMPLES, "cycles");
+  bench_report("  max", lat_max, "cycles");
+}
+
+int main(void)
+{
+  uart_tx_init(UART_TX_UNBUFFERED);
+  enable_interrupt();
+  print("\n==== Timer interrupt entry latency ====\n");
+  run("direct mtvec, full frame", (unsigned) _isr_handler);
+  run("vectored mtvec, caller-saved frame", (unsigned) _vector_table | 1);
+  while (1);
+}
@@ -0,0 +1,129 @@
+/* bench_irq_latency.c
+
+   Timer interrupt latency under different background loads. The Avalon
+   timer runs in continuous mode with a 1 ms period. At the top of the
+   handler, timer_health_tick reads the snapshot registers. The count
+   since the timeout is the latency from interrupt assertion to handler
+   entry, including the snapshot read itself. mcycle is used to tell
+   whether whole periods went by without an interrupt. Each load prints
+   a histogram of latencies in 32-cycle buckets along with the
+   late/missed counters. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define TIMER ((volatile int *) 0x04000020)
+#define PERIOD  30000               /* 1 ms at 30 MHz */
+#define SAMPLES 500
+#define BUCKET  32
+#define BUCKETS 64                  /* Last bucket: BUCKET * BUCKETS and up */
+
+static const char line[] =
+  "The quick brown fox jumps over the lazy dog 0123456789 ABCDEF.\n";
+#define LINE_LEN (sizeof(line) - 1)
+
+static struct timer_health health;
+static unsigned hist[BUCKETS];
+static volatile unsigned samples;
+static unsigned lat_min, lat_total;
+static unsigned copy_a[1024], copy_b[1024];
+
+void handle_interrupt(unsigned cause)
+{
+  if (cause == 16) {
+    unsigned lat = timer_health_tick(&health);
+
+    TIMER[0] = 0;
+    if (samples < SAMPLES) {
+      hist[lat / BUCKET < BUCKETS ? lat / BUCKET : BUCKETS - 1]++;
+      if (lat < lat_min)
+        lat_min = lat;
+      lat_total += lat;
+      samples++;
+    }
+  } else if (cause == JTAG_UART_IRQ) {
+    uart_tx_isr();
+  }
+}
+
+static void load_idle(void)       { }
+static void load_wfi(void)        { asm volatile ("wfi"); }
+static void load_print(void)      { print(line); }
+static void load_ecall(void)      { sys_write_buf(line, LINE_LEN); }
+static void load_memcpy(void)     { memcpy(copy_a, copy_b, sizeof(copy_a)); }
+
+/* Interrupts off for a while, like a handler that calls delay */
+static void load_masked_100us(void)
+{
+  unsigned flags = irq_save();
+  delay_us(100);
+  irq_restore(flags);
+}
+
+static void load_masked_2ms(void)
+{
+  unsigned flags = irq_save();
+  delay_ms(2);
+  irq_restore(flags);
+}
+
+static void run(const char *name, void (*load)(void), int policy)
+{
+  uart_tx_init(policy);
+  memset(hist, 0, sizeof(hist));
+  lat_min = ~0u;
+  lat_total = 0;
+  samples = 0;
+
+  TIMER[1] = 0x8;                           /* STOP */
+  TIMER[0] = 0;
+  TIMER[2] = (PERIOD - 1) & 0xFFFF;
+  TIMER[3] = (PERIOD - 1) >> 16;
+  TIMER[1] = 0x7;                           /* ITO | CONT | START */
+  timer_health_init(&health, PERIOD, TIMER_LATE_CYCLES);
+  while (samples < SAMPLES)
+    load();
+  TIMER[1] = 0x8;
+  TIMER[0] = 0;
+
+  uart_tx_flush();
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print(name);
+  printc('\n');
+  bench_report("  min", lat_min, "cycles");
+  bench_report("  avg", lat_total / SAMPLES, "cycles");
+  timer_health_dump("  counters", &health);
+  for (int b = 0; b < BUCKETS; b++) {
+    if (hist[b] == 0)
+      continue;
+    print("  ");
+    print_dec(b * BUCKET);
+    if (b == BUCKETS - 1) {
+      print("+");
+    } else {
+      printc('-');
+      print_dec(b * BUCKET + BUCKET - 1);
+    }
+    print(": ");
+    print_dec(hist[b]);
+    printc('\n');
+  }
+}
+
+int main(void)
+{
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== Timer interrupt latency under load ====\n");
+  enable_interrupt();
+
+  run("idle loop", load_idle, UART_TX_UNBUFFERED);
+  run("wfi", load_wfi, UART_TX_UNBUFFERED);
+  run("print, unbuffered (FIFO spin)", load_print, UART_TX_UNBUFFERED);
+  run("print, buffered", load_print, UART_TX_DROP);
+  run("ecall SYS_WRITE (trap masks interrupts)", load_ecall, UART_TX_DROP);
+  run("memcpy 4 KB", load_memcpy, UART_TX_UNBUFFERED);
+  run("interrupts masked 100 us", load_masked_100us, UART_TX_UNBUFFERED);
+  run("interrupts masked 2 ms", load_masked_2ms, UART_TX_UNBUFFERED);
+
+  while (1);
+}
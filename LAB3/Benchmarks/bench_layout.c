@@ -0,0 +1,92 @@
+/* bench_layout.c
+
+   Cycles per iteration of labmain's prime loop (prime stream, buffered
+   print, deferred work, task yield) with the timer service ticking,
+   and of an ecall round trip, the code that dtekv-hot.ld packs next to
+   the trap vector. Build it twice to compare layouts:
+
+     make BENCH=layout run             hot functions first
+     make BENCH=layout LAYOUT=0 run    plain link order
+
+   The addresses printed at the end show where the layout put things. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define ITERATIONS 4000
+#define ECALLS     1000
+#define TICK       30000
+
+#define PRIME_SEGMENT_WORDS 512
+#define PRIME_WORK_WORDS    (2 * PRIME_SEGMENT_WORDS + 2 * 1024)
+static unsigned prime_work[PRIME_WORK_WORDS];
+static struct prime_stream primes;
+static struct soft_timer uart_timer;
+volatile unsigned sink;
+
+void handle_interrupt(unsigned cause)
+{
+  if (cause == 16)
+    timer_isr();
+  else if (cause == JTAG_UART_IRQ)
+    uart_tx_isr();
+}
+
+static void uart_poll(unsigned arg)
+{
+  uart_tx_isr();
+}
+
+static void address(const char *name, void *fn)
+{
+  print("  ");
+  print(name);
+  print(" at 0x");
+  print_hex32((unsigned) fn);
+  printc('\n');
+}
+
+int main(void)
+{
+  unsigned t, loop, ecall;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== Hot/cold .text layout ====\n");
+
+  /* Output is dropped when the ring is full so UART speed stays out */
+  uart_tx_init(UART_TX_DROP);
+  timer_service_init(TICK);
+  timer_start(&uart_timer, 10, 10, uart_poll, 0);
+  task_init();
+  prime_stream_init(&primes, 1234567, prime_work, PRIME_WORK_WORDS,
+                    PRIME_SEGMENT_WORDS);
+  enable_interrupt();
+
+  t = bench_cycles();
+  for (int i = 0; i < ITERATIONS; i++) {
+    print("Prime: ");
+    print_dec(prime_stream_next(&primes));
+    print("\n");
+    work_run();
+    task_yield();
+  }
+  loop = bench_cycles() - t;
+
+  t = bench_cycles();
+  for (int i = 0; i < ECALLS; i++)
+    sink = sys_read_cycles();
+  ecall = bench_cycles() - t;
+
+  uart_tx_flush();
+  uart_tx_init(UART_TX_UNBUFFERED);
+  bench_report("prime loop", loop / ITERATIONS, "cycles/iteration");
+  bench_report("ecall round trip", ecall / ECALLS, "cycles/iteration");
+  bench_report("timer ticks", timer_now(), "during the run");
+  address("handle_interrupt", handle_interrupt);
+  address("timer_isr", timer_isr);
+  address("prime_stream_next", prime_stream_next);
+  address("printc", printc);
+  address("timer_service_init (cold)", timer_service_init);
+
+  while (1);
+}
@@ -0,0 +1,78 @@
+/* bench_prime.c
+
+   Primes per second for nextprime against the original trial-division
+   loop, walking consecutive primes from several starting points. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define WINDOW_CYCLES (BENCH_CLOCK_HZ / 2)   /* Half a second per run */
+#define LEGACY_MAX    1234567                /* Beyond this one legacy prime takes minutes */
+
+static const int starts[] = { 1000, 100000, 1234567, 100000000, 2000000000 };
+#define STARTS (sizeof(starts) / sizeof(starts[0]))
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+/* The original nextprime: every integer from 3 up to perhapsprime/2. */
+static __attribute__((noinline)) int legacy_nextprime(int inval)
+{
+  int perhapsprime = 0;
+  int testfactor;
+  int found;
+
+  if (inval < 3) {
+    if (inval <= 0) return 1;
+    if (inval == 1) return 2;
+    if (inval == 2) return 3;
+  } else {
+    perhapsprime = (inval + 1) | 1;
+  }
+  for (found = 0; found != 1; perhapsprime += 2) {
+    for (testfactor = 3; testfactor <= (perhapsprime >> 1) + 1; testfactor += 1) {
+      found = 1;
+      if ((perhapsprime % testfactor) == 0) {
+        found = 0;
+        goto check_next_prime;
+      }
+    }
+    check_next_prime:;
+    if (found == 1)
+      return perhapsprime;
+  }
+  return perhapsprime;
+}
+
+/* Count primes found from start until the window runs out. At least
+   one prime is always completed, so slow runs still report a rate. */
+static void run(const char *name, int (*next)(int), int start)
+{
+  unsigned t0 = bench_cycles(), elapsed;
+  unsigned count = 0;
+  int p = start;
+
+  do {
+    p = next(p);
+    count++;
+    elapsed = bench_cycles() - t0;
+  } while (elapsed < WINDOW_CYCLES);
+
+  print(name);
+  print(" from ");
+  print_dec(start);
+  bench_report("", bench_per_second(count, elapsed), "primes/s");
+}
+
+int main(void)
+{
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== nextprime ====\n");
+  for (int i = 0; i < STARTS; i++) {
+    if (starts[i] <= LEGACY_MAX)
+      run("legacy  ", legacy_nextprime, starts[i]);
+    run("nextprime", nextprime, starts[i]);
+  }
+  while (1);
+}
@@ -0,0 +1,45 @@
+/* bench_prof.c
+
+   Cost of the profiling probes themselves: an empty PROF_BEGIN/PROF_END
+   pair, as seen by the probe and by an outside cycle count. Build with
+   make BENCH=prof PROF=1. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define RUNS 1000
+
+enum { PROBE_EMPTY, PROBE_LOOP };
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+int main(void)
+{
+  unsigned t0, outside;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  prof_name(PROBE_EMPTY, "empty probe");
+  prof_name(PROBE_LOOP, "10-step loop");
+
+  t0 = bench_cycles();
+  for (int i = 0; i < RUNS; i++) {
+    PROF_BEGIN(PROBE_EMPTY);
+    PROF_END(PROBE_EMPTY);
+  }
+  outside = bench_cycles() - t0;
+
+  for (int i = 0; i < RUNS; i++) {
+    PROF_BEGIN(PROBE_LOOP);
+    for (volatile int j = 0; j < 10; j++)
+      ;
+    PROF_END(PROBE_LOOP);
+  }
+
+  print("\n==== Profiling probes ====\n");
+  bench_report("probe + bookkeeping", outside / RUNS, "cycles");
+  prof_dump();
+
+  while (1);
+}
@@ -0,0 +1,183 @@
+/* bench_ring.c
+
+   The lock-free SPSC ring (RING_DECLARE) and the event queue built on
+   it. Throughput is measured in the main loop alone: fill the ring,
+   then empty it one item at a time or with one batch call, against
+   work_queue/work_run, which mask interrupts around every put. The
+   enqueue cost is measured where it matters, inside a 100 us timer
+   interrupt, with the main loop draining in batches, then with nobody
+   draining so every post takes the ring-full path. The drain phase
+   also checks that no event is lost or reordered and reports how long
+   events waited between post and drain. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define TIMER ((volatile int *) 0x04000020)
+#define PERIOD  3000                /* 100 us at 30 MHz */
+#define ROUNDS  64
+#define SAMPLES 5000
+#define BATCH   16
+
+RING_DECLARE(word_ring, unsigned, 64)
+
+static struct word_ring ring;
+static unsigned words[64];
+static struct event batch[EVENT_RING_SIZE];
+
+static volatile unsigned posts;
+static volatile int use_work;
+static unsigned post_max, post_total;
+static unsigned work_sink;
+
+static void nop_work(unsigned arg)
+{
+  work_sink += arg;
+}
+
+void handle_interrupt(unsigned cause)
+{
+  unsigned t;
+
+  if (cause != 16)
+    return;
+  TIMER[0] = 0;
+  if (posts >= SAMPLES)
+    return;
+  t = bench_cycles();
+  if (use_work)
+    work_queue(nop_work, posts);
+  else
+    event_post(EV_TICK, posts);
+  t = bench_cycles() - t;
+  if (t > post_max)
+    post_max = t;
+  post_total += t;
+  posts++;
+}
+
+static void report_rate(const char *name, unsigned cycles, unsigned items)
+{
+  print(name);
+  print(": ");
+  print_dec(cycles / items);
+  print(" cycles/item, ");
+  print_dec(bench_per_second(items, cycles));
+  print(" items/s\n");
+}
+
+static void throughput(void)
+{
+  unsigned t, v, n = 0;
+
+  t = bench_cycles();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (unsigned i = 0; i < 64; i++)
+      word_ring_put(&ring, &i);
+    while (word_ring_get(&ring, &v))
+      n += v;
+  }
+  report_rate("ring put + get", bench_cycles() - t, ROUNDS * 64);
+
+  t = bench_cycles();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (unsigned i = 0; i < 64; i++)
+      word_ring_put(&ring, &i);
+    n += word_ring_get_batch(&ring, words, 64);
+  }
+  report_rate("ring put + get_batch", bench_cycles() - t, ROUNDS * 64);
+
+  t = bench_cycles();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (unsigned i = 0; i < EVENT_RING_SIZE; i++)
+      event_post(EV_TICK, i);
+    n += event_drain(batch, EVENT_RING_SIZE);
+  }
+  report_rate("event_post + event_drain", bench_cycles() - t,
+              ROUNDS * EVENT_RING_SIZE);
+
+  t = bench_cycles();
+  for (int r = 0; r < ROUNDS * 64 / WORK_QUEUE_SIZE; r++) {
+    for (unsigned i = 0; i < WORK_QUEUE_SIZE; i++)
+      work_queue(nop_work, i);
+    n += work_run();
+  }
+  report_rate("work_queue + work_run", bench_cycles() - t, ROUNDS * 64);
+
+  if (n == 0)
+    print("(no items)\n");
+}
+
+static void ticks_start(void)
+{
+  post_max = post_total = 0;
+  posts = 0;
+  TIMER[1] = 0x8;                           /* STOP */
+  TIMER[0] = 0;
+  TIMER[2] = (PERIOD - 1) & 0xFFFF;
+  TIMER[3] = (PERIOD - 1) >> 16;
+  TIMER[1] = 0x7;                           /* ITO | CONT | START */
+}
+
+static void ticks_stop(const char *name)
+{
+  TIMER[1] = 0x8;
+  TIMER[0] = 0;
+  print(name);
+  print(": enqueue in the ISR avg ");
+  print_dec(post_total / SAMPLES);
+  print(", max ");
+  print_dec(post_max);
+  print(" cycles\n");
+}
+
+static void from_isr(void)
+{
+  unsigned expect = 0, bad = 0, wait_max = 0, batches = 0, lost;
+
+  /* Main loop drains in batches */
+  use_work = 0;
+  ticks_start();
+  while (expect < SAMPLES) {
+    unsigned n = event_drain(batch, BATCH);
+    unsigned now = bench_cycles();
+    for (unsigned i = 0; i < n; i++) {
+      if (batch[i].data != expect++)
+        bad++;
+      if (now - batch[i].cycle > wait_max)
+        wait_max = now - batch[i].cycle;
+    }
+    if (n)
+      batches++;
+  }
+  ticks_stop("event_post, draining");
+  bench_report("  batches", batches, "");
+  bench_report("  out of order", bad, "");
+  bench_report("  longest wait", wait_max, "cycles");
+
+  /* Nobody drains: every post after the first EVENT_RING_SIZE is refused */
+  lost = event_overflows();
+  ticks_start();
+  while (posts < SAMPLES);
+  ticks_stop("event_post, ring full");
+  bench_report("  dropped", event_overflows() - lost, "");
+  while (event_drain(batch, EVENT_RING_SIZE));
+
+  use_work = 1;
+  ticks_start();
+  while (posts < SAMPLES)
+    work_run();
+  ticks_stop("work_queue, draining");
+}
+
+int main(void)
+{
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== SPSC ring and event queue ====\n");
+
+  throughput();
+  enable_interrupt();
+  from_isr();
+
+  while (1);
+}
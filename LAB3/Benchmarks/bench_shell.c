@@ -0,0 +1,68 @@
+/* bench_shell.c
+
+   What the receive path and the shell cost a main loop that polls them.
+   uart_rx_isr with an empty FIFO is one MMIO read, and shell_poll with
+   nothing received is one ring check; both run on every pass. Parsing
+   and running a command only happens when a line comes in. Type a line
+   into dtekv-shell while the last part waits to see a real one go
+   through. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define N 1000
+
+static int step = 1;
+
+void handle_interrupt(unsigned cause)
+{
+  if (cause == JTAG_UART_IRQ)
+    uart_rx_isr();
+}
+
+static void exec_cost(const char *name, const char *text)
+{
+  char line[SHELL_LINE_SIZE];
+  unsigned t;
+  int i = 0;
+
+  while ((line[i] = text[i]) != '\0')
+    i++;
+  t = bench_cycles();
+  shell_exec(line);
+  t = bench_cycles() - t;
+  bench_report(name, t, "cycles (including its output)");
+}
+
+int main(void)
+{
+  unsigned t;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== JTAG UART receive and shell ====\n");
+  shell_init();
+  shell_var("step", &step);
+  printc('\n');
+
+  t = bench_cycles();
+  for (int i = 0; i < N; i++)
+    uart_rx_isr();
+  bench_report("uart_rx_isr, FIFO empty", (bench_cycles() - t) / N, "cycles");
+
+  t = bench_cycles();
+  for (int i = 0; i < N; i++)
+    shell_poll();
+  bench_report("shell_poll, nothing received", (bench_cycles() - t) / N, "cycles");
+
+  exec_cost("set step 5", "set step 5");
+  exec_cost("get step", "get step");
+  exec_cost("unknown command", "bogus");
+
+  print("type a line to time it end to end\n");
+  enable_interrupt();
+  while (1) {
+    t = bench_cycles();
+    if (shell_poll())
+      bench_report("shell_poll with a line", bench_cycles() - t, "cycles");
+  }
+}
@@ -0,0 +1,66 @@
+/* bench_sieve.c
+
+   Consecutive primes per second from the segmented prime stream at
+   several segment sizes, against calling nextprime in a loop, with the
+   worst single prime_stream_next call for each size. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define START          1234567
+#define PRIMES         20000
+#define SIEVING_PRIMES 1024
+#define MAX_SEGMENT    4096
+
+static const unsigned segments[] = { 32, 128, 512, 2048, MAX_SEGMENT };
+#define SEGMENTS (sizeof(segments) / sizeof(segments[0]))
+
+static unsigned work[2 * MAX_SEGMENT + 2 * SIEVING_PRIMES];
+static struct prime_stream ps;
+volatile unsigned sink;
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+static void run_stream(unsigned words)
+{
+  unsigned worst = 0, total;
+  unsigned t0 = bench_cycles();
+
+  prime_stream_init(&ps, START, work, 2 * words + 2 * SIEVING_PRIMES, words);
+  for (int i = 0; i < PRIMES; i++) {
+    unsigned t = bench_cycles();
+    sink = prime_stream_next(&ps);
+    t = bench_cycles() - t;
+    if (t > worst)
+      worst = t;
+  }
+  total = bench_cycles() - t0;
+
+  print("segment ");
+  print_dec(words * 4);
+  print(" bytes");
+  bench_report("", bench_per_second(PRIMES, total), "primes/s");
+  bench_report("  worst call", worst, "cycles");
+}
+
+int main(void)
+{
+  unsigned t0;
+  int p = START;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== Prime stream from 1234567 ====\n");
+
+  t0 = bench_cycles();
+  for (int i = 0; i < PRIMES; i++)
+    p = nextprime(p);
+  sink = p;
+  bench_report("nextprime loop", bench_per_second(PRIMES, bench_cycles() - t0), "primes/s");
+
+  for (int i = 0; i < SEGMENTS; i++)
+    run_stream(segments[i]);
+
+  while (1);
+}
@@ -0,0 +1,90 @@
+/* bench_string.c
+
+   Throughput of memcpy, memmove (overlapping, backwards), memset and
+   memcmp (equal buffers, so the whole length is compared) for sizes
+   from 16 bytes to 4 KB and several source/destination alignments,
+   with a plain byte loop copy for reference. Results are in bytes per
+   100 cycles. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#pragma GCC optimize ("no-tree-loop-distribute-patterns")
+
+#define MAX  4096
+#define REPS 16
+
+static unsigned buf_a[MAX / 4 + 4], buf_b[MAX / 4 + 8];
+static const unsigned sizes[] = { 16, 64, 256, 1024, 4096 };
+#define SIZES (sizeof(sizes) / sizeof(sizes[0]))
+static const unsigned offsets[][2] = { { 0, 0 }, { 1, 1 }, { 0, 1 }, { 3, 0 }, { 2, 1 } };
+#define OFFSETS (sizeof(offsets) / sizeof(offsets[0]))
+
+volatile int sink;
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+static void byte_copy(unsigned char *d, const unsigned char *s, unsigned n)
+{
+  while (n--)
+    *d++ = *s++;
+}
+
+static void rate(const char *name, unsigned n, unsigned cycles)
+{
+  print("  ");
+  bench_report(name, n * REPS * 100 / (cycles ? cycles : 1), "bytes/100 cycles");
+}
+
+int main(void)
+{
+  unsigned char *a = (unsigned char *) buf_a, *b = (unsigned char *) buf_b;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== Memory primitives ====\n");
+  memset(buf_a, 0x5A, sizeof(buf_a));
+  memset(buf_b, 0x5A, sizeof(buf_b));
+
+  for (int i = 0; i < SIZES; i++)
+    for (int j = 0; j < OFFSETS; j++) {
+      unsigned n = sizes[i], t;
+      unsigned char *d = b + offsets[j][0], *s = a + offsets[j][1];
+
+      print_dec(n);
+      print(" bytes, dst+");
+      print_dec(offsets[j][0]);
+      print(" src+");
+      print_dec(offsets[j][1]);
+      printc('\n');
+
+      t = bench_cycles();
+      for (int r = 0; r < REPS; r++)
+        byte_copy(d, s, n);
+      rate("byte loop", n, bench_cycles() - t);
+
+      t = bench_cycles();
+      for (int r = 0; r < REPS; r++)
+        memcpy(d, s, n);
+      rate("memcpy", n, bench_cycles() - t);
+
+      t = bench_cycles();
+      for (int r = 0; r < REPS; r++)
+        memmove(b + 4 + offsets[j][0], b + offsets[j][1], n);
+      rate("memmove overlap", n, bench_cycles() - t);
+
+      t = bench_cycles();
+      for (int r = 0; r < REPS; r++)
+        memset(d, r, n);
+      rate("memset", n, bench_cycles() - t);
+
+      memcpy(d, s, n);
+      t = bench_cycles();
+      for (int r = 0; r < REPS; r++)
+        sink = memcmp(d, s, n);
+      rate("memcmp", n, bench_cycles() - t);
+    }
+
+  while (1);
+}
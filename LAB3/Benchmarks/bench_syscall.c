@@ -0,0 +1,81 @@
+/* bench_syscall.c
+
+   ecall round-trip cost through the syscall table, and the cost of
+   sending a line one character per trap (the old display_string path
+   for its newline, or a print loop) against one bulk write. Output is
+   queued with the drop policy so UART speed does not enter the numbers. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define RUNS 256
+
+static const char line[] =
+  "The quick brown fox jumps over the lazy dog 0123456789 ABCDEF.";
+#define LINE_LEN (sizeof(line) - 1)
+
+void handle_interrupt(unsigned cause)
+{
+  if (cause == JTAG_UART_IRQ)
+    uart_tx_isr();
+}
+
+static void report(const char *name, unsigned cycles)
+{
+  bench_report(name, cycles / RUNS, "cycles");
+}
+
+int main(void)
+{
+  unsigned t0;
+  unsigned null_call, unknown_call, per_char, print_nl, puts_call, write_call;
+
+  enable_interrupt();
+  uart_tx_init(UART_TX_DROP);
+
+  t0 = bench_cycles();
+  for (int i = 0; i < RUNS; i++)
+    sys_read_cycles();
+  null_call = bench_cycles() - t0;
+
+  t0 = bench_cycles();
+  for (int i = 0; i < RUNS; i++)
+    syscall3(SYSCALL_MAX - 1, 0, 0, 0);
+  unknown_call = bench_cycles() - t0;
+
+  /* One trap per character. */
+  t0 = bench_cycles();
+  for (int i = 0; i < RUNS; i++)
+    for (int c = 0; c < LINE_LEN; c++)
+      syscall3(SYS_PRINT_CHAR, line[c], 0, 0);
+  per_char = bench_cycles() - t0;
+
+  /* The previous display_string: string, then newline in a second trap. */
+  t0 = bench_cycles();
+  for (int i = 0; i < RUNS; i++) {
+    syscall3(SYS_PRINT_STRING, (unsigned) line, 0, 0);
+    syscall3(SYS_PRINT_CHAR, '\n', 0, 0);
+  }
+  print_nl = bench_cycles() - t0;
+
+  t0 = bench_cycles();
+  for (int i = 0; i < RUNS; i++)
+    syscall3(SYS_PUTS, (unsigned) line, 0, 0);
+  puts_call = bench_cycles() - t0;
+
+  t0 = bench_cycles();
+  for (int i = 0; i < RUNS; i++)
+    sys_write_buf(line, LINE_LEN);
+  write_call = bench_cycles() - t0;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== ecall round trips ====\n");
+  report("SYS_CYCLES round trip", null_call);
+  report("unregistered call", unknown_call);
+  report("line, one trap per char", per_char);
+  report("line + newline, 2 traps", print_nl);
+  report("line via SYS_PUTS", puts_call);
+  report("line via SYS_WRITE", write_call);
+
+  while (1);
+}
@@ -0,0 +1,85 @@
+/* bench_task.c
+
+   Cooperative scheduler costs: cycles for a task_yield that finds
+   nothing else to run, for a switch between two tasks (main and a
+   partner that yields straight back), for the same switch through the
+   SYS_YIELD ecall, and the wake-up delay of task_sleep(1). */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define ROUNDS 10000
+#define SLEEPS 100
+#define TICK   3000     /* Cycles per tick (100 us) */
+
+static struct task partner;
+volatile int partner_mode;   /* 0: task_yield, 1: sys_yield_cpu */
+
+void handle_interrupt(unsigned cause)
+{
+  if (cause == 16)
+    timer_isr();
+}
+
+static void partner_run(unsigned arg)
+{
+  while (1) {
+    if (partner_mode)
+      sys_yield_cpu();
+    else
+      task_yield();
+  }
+}
+
+int main(void)
+{
+  unsigned t0, late, worst;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  timer_service_init(TICK);
+  task_init();
+  enable_interrupt();
+  print("\n==== Cooperative scheduler ====\n");
+
+  t0 = bench_cycles();
+  for (int i = 0; i < ROUNDS; i++)
+    task_yield();
+  bench_report("yield, nothing ready", (bench_cycles() - t0) / ROUNDS, "cycles");
+
+  task_create(&partner, "partner", partner_run, 0, 512);
+  task_yield();                       /* Let it start */
+
+  /* Each round is two switches: main to partner and back. */
+  partner_mode = 0;
+  t0 = bench_cycles();
+  for (int i = 0; i < ROUNDS; i++)
+    task_yield();
+  bench_report("task_yield switch", (bench_cycles() - t0) / (2 * ROUNDS), "cycles");
+
+  partner_mode = 1;
+  task_yield();                       /* Partner picks up the new mode */
+  t0 = bench_cycles();
+  for (int i = 0; i < ROUNDS; i++)
+    sys_yield_cpu();
+  bench_report("SYS_YIELD switch", (bench_cycles() - t0) / (2 * ROUNDS), "cycles");
+
+  /* Sleep with the partner spinning, so wake-ups wait for a yield. */
+  partner_mode = 0;
+  late = worst = 0;
+  for (int i = 0; i < SLEEPS; i++) {
+    unsigned start = timer_now();
+    t0 = bench_cycles();
+    task_sleep(1);
+    t0 = bench_cycles() - t0;
+    if (timer_now() - start < 1)
+      print("woke early\n");
+    late += t0;
+    if (t0 > worst)
+      worst = t0;
+  }
+  bench_report("task_sleep(1) avg", late / SLEEPS, "cycles");
+  bench_report("task_sleep(1) max", worst, "cycles");
+  bench_report("tick", TICK, "cycles");
+
+  while (1);
+}
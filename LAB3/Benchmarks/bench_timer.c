@@ -0,0 +1,171 @@
+/* bench_timer.c
+
+   Stress test of the software timer wheel: thousands of timers with
+   random delays, one in four periodic. Reports the cost of starting
+   and cancelling a timer, the cycles spent per timer interrupt, and
+   how late callbacks run against their due cycle. A last check has
+   several timers due in the same tick, the first of them restarting
+   another that has not run yet: every one must still run, and the
+   periodic one among them keep running. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define TIMERS      2048
+#define TICK        3000        /* Cycles per tick (100 us) */
+#define MAX_DELAY   2000        /* Ticks, several wheel turns */
+#define RUN_TICKS   10000       /* Length of the firing phase (1 s) */
+
+static struct soft_timer timers[TIMERS];
+static unsigned due[TIMERS];    /* Cycle at which each timer should fire */
+static unsigned periods[TIMERS];
+static unsigned seed = 12345;
+
+#define SAME        8           /* Timers due in the same tick */
+#define SAME_PERIOD 10          /* Ticks, for same[SAME - 1] */
+#define SAME_WAIT   100         /* Ticks to watch them */
+static struct soft_timer same[SAME];
+static unsigned same_runs[SAME];
+static int same_restarted;
+
+volatile unsigned fires;
+unsigned late_max, late_total;
+unsigned isr_count, isr_max, isr_total;
+
+static unsigned rnd(unsigned n)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) % n;
+}
+
+static void fired(unsigned i)
+{
+  int late = (int) (bench_cycles() - due[i]);
+
+  if (late > 0) {
+    if (late > late_max)
+      late_max = late;
+    late_total += late;
+  }
+  fires++;
+  due[i] += periods[i] * TICK;
+}
+
+/* The first callback of the tick restarts the timer started just before
+   its own, with its period kept. Slot lists are LIFO, so that one is
+   next in line and every other due timer is still queued behind it. */
+static void same_fired(unsigned i)
+{
+  unsigned j = (i + SAME - 1) % SAME;
+
+  same_runs[i]++;
+  if (same_restarted)
+    return;
+  same_restarted = 1;
+  timer_start(&same[j], 1, j == SAME - 1 ? SAME_PERIOD : 0, same_fired, j);
+}
+
+static void restart_in_callback(void)
+{
+  unsigned never = 0, end;
+
+  for (unsigned i = 0; i < SAME; i++)
+    timer_start(&same[i], 5, i == SAME - 1 ? SAME_PERIOD : 0, same_fired, i);
+  end = bench_cycles() + SAME_WAIT * TICK;
+  while ((int) (end - bench_cycles()) > 0)
+    ;
+  for (unsigned i = 0; i < SAME; i++) {
+    timer_cancel(&same[i]);
+    if (same_runs[i] == 0)
+      never++;
+  }
+  bench_report("restart in a callback, timers never run", never, "");
+  bench_report("  periodic runs", same_runs[SAME - 1], "");
+  bench_report("  expected at least", (SAME_WAIT - 6) / SAME_PERIOD, "");
+}
+
+void handle_interrupt(unsigned cause)
+{
+  unsigned t = bench_cycles();
+
+  if (cause != 16)
+    return;
+  timer_isr();
+  t = bench_cycles() - t;
+  if (t > isr_max)
+    isr_max = t;
+  isr_total += t;
+  isr_count++;
+}
+
+/* Start timer i with a random delay; due is measured from the call, so
+   a callback can be up to one tick early when it starts mid-tick. */
+static unsigned start(int i)
+{
+  unsigned delay = 1 + rnd(MAX_DELAY);
+  unsigned t;
+
+  periods[i] = rnd(4) == 0 ? 50 + rnd(250) : 0;
+  due[i] = bench_cycles() + delay * TICK;
+  t = bench_cycles();
+  timer_start(&timers[i], delay, periods[i], fired, i);
+  return bench_cycles() - t;
+}
+
+int main(void)
+{
+  unsigned total, worst, t, end;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  timer_service_init(TICK);
+  enable_interrupt();
+  print("\n==== Software timer wheel, 2048 timers ====\n");
+
+  total = worst = 0;
+  for (int i = 0; i < TIMERS; i++) {
+    t = start(i);
+    if (t > worst)
+      worst = t;
+    total += t;
+  }
+  bench_report("timer_start avg", total / TIMERS, "cycles");
+  bench_report("timer_start max", worst, "cycles");
+
+  total = worst = 0;
+  for (int i = 0; i < TIMERS; i += 2) {
+    t = bench_cycles();
+    timer_cancel(&timers[i]);
+    t = bench_cycles() - t;
+    if (t > worst)
+      worst = t;
+    total += t;
+  }
+  bench_report("timer_cancel avg", total / (TIMERS / 2), "cycles");
+  bench_report("timer_cancel max", worst, "cycles");
+
+  /* Firing phase: restart the cancelled half and let everything run. */
+  for (int i = 0; i < TIMERS; i += 2)
+    start(i);
+  fires = late_max = late_total = 0;
+  isr_count = isr_max = isr_total = 0;
+  end = bench_cycles() + RUN_TICKS * TICK;
+  while ((int) (end - bench_cycles()) > 0)
+    ;
+  for (int i = 0; i < TIMERS; i++)
+    timer_cancel(&timers[i]);
+
+  bench_report("callbacks", fires, "");
+  bench_report("timer interrupts", isr_count, "");
+  if (isr_count) {
+    bench_report("timer_isr avg", isr_total / isr_count, "cycles");
+    bench_report("timer_isr max", isr_max, "cycles");
+  }
+  if (fires)
+    bench_report("lateness avg", late_total / fires, "cycles");
+  bench_report("lateness max", late_max, "cycles");
+  bench_report("timer_now", timer_now(), "ticks");
+
+  restart_in_callback();
+
+  while (1);
+}
@@ -0,0 +1,112 @@
+/* bench_uart.c
+
+   JTAG UART transmit benchmark: characters per second and CPU time
+   returned to a compute loop, unbuffered versus the interrupt-drained
+   ring buffer.
+
+   The CPU time is measured in a fixed window with output paced below
+   what the host drains, so neither mode is bound by the link: the
+   number of work() calls completed counts the cycles left for compute
+   once print, and for the ring the UART interrupt, have taken theirs.
+   The cycles spent inside print are reported as well. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define LINES       256
+#define WORK_STEPS  64
+#define WINDOW      (BENCH_CLOCK_HZ / 2)       /* Half a second */
+#define LINE_PERIOD (BENCH_CLOCK_HZ / 250)     /* 250 lines/s, 16000 chars/s */
+
+static const char line[] =
+  "The quick brown fox jumps over the lazy dog 0123456789 ABCDEF.\n";
+#define LINE_LEN (sizeof(line) - 1)
+
+volatile unsigned sink;
+
+void handle_interrupt(unsigned cause)
+{
+  if (cause == JTAG_UART_IRQ)
+    uart_tx_isr();
+}
+
+/* A fixed slice of compute standing in for the nextprime loop. */
+static void work(void)
+{
+  unsigned x = sink;
+  for (int i = 0; i < WORK_STEPS; i++)
+    x = x * 1664525 + 1013904223;
+  sink = x;
+}
+
+/* Write every line back to back; returns cycles until the FIFO has
+   accepted the last byte. */
+static unsigned burst(void)
+{
+  unsigned t0 = bench_cycles();
+  for (int i = 0; i < LINES; i++)
+    print(line);
+  uart_tx_flush();
+  return bench_cycles() - t0;
+}
+
+/* Compute for WINDOW cycles, printing a line every LINE_PERIOD; returns
+   the work() calls completed and adds the cycles spent in print to
+   *print_cycles. Output still queued at the end is flushed outside the
+   window. */
+static unsigned mixed(unsigned *print_cycles)
+{
+  unsigned t0 = bench_cycles(), next = t0, now, done = 0;
+
+  *print_cycles = 0;
+  while ((now = bench_cycles()) - t0 < WINDOW) {
+    if ((int) (now - next) >= 0) {
+      print(line);
+      *print_cycles += bench_cycles() - now;
+      next += LINE_PERIOD;
+    }
+    work();
+    done++;
+  }
+  uart_tx_flush();
+  return done;
+}
+
+int main(void)
+{
+  unsigned chars = LINES * LINE_LEN;
+  unsigned direct_burst, direct_mixed, ring_burst, ring_mixed;
+  unsigned direct_print, ring_print, lines = WINDOW / LINE_PERIOD;
+
+  enable_interrupt();
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  direct_burst = burst();
+  direct_mixed = mixed(&direct_print);
+
+  uart_tx_init(UART_TX_BLOCK);
+  ring_burst = burst();
+  ring_mixed = mixed(&ring_print);
+
+  uart_tx_init(UART_TX_DROP);
+  for (int i = 0; i < LINES; i++)
+    print(line);
+  uart_tx_flush();
+  unsigned dropped = uart_tx_dropped();
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  print("\n==== JTAG UART transmit ====\n");
+  bench_report("unbuffered", bench_per_second(chars, direct_burst), "chars/s");
+  bench_report("ring buffer", bench_per_second(chars, ring_burst), "chars/s");
+  bench_report("unbuffered print", direct_print / lines, "cycles/line");
+  bench_report("ring print", ring_print / lines, "cycles/line");
+  bench_report("unbuffered work() in 0.5 s", direct_mixed, "calls");
+  bench_report("ring work() in 0.5 s", ring_mixed, "calls");
+  if (ring_mixed > direct_mixed)
+    bench_report("CPU time freed", (ring_mixed - direct_mixed) / (ring_mixed / 100), "%");
+  else
+    bench_report("CPU time freed", 0, "%");
+  bench_report("drop policy lost", dropped, "chars");
+
+  while (1);
+}
@@ -0,0 +1,107 @@
+/* bench_vga.c
+
+   Frames per second on the VGA back buffer: full-screen clears alone
+   and with a double-buffer swap (which waits for vertical sync), then a
+   sprite scene of 64 moving 16x16 sprites, opaque and colour-keyed,
+   and a frame of 100 lines. */
+
+#include "dtekv-lib.h"
+#include "bench.h"
+
+#define FRAMES  60
+#define SPRITES 64
+#define SIZE    16
+
+static unsigned char sprite[SIZE * SIZE];
+static int sx[SPRITES], sy[SPRITES], vx[SPRITES], vy[SPRITES];
+
+void handle_interrupt(unsigned cause)
+{
+}
+
+static void report_fps(const char *name, unsigned frames, unsigned cycles)
+{
+  bench_report(name, bench_per_second(frames, cycles), "frames/s");
+}
+
+/* Advance every sprite, bouncing a little past the edges so the
+   clipping paths get exercised. */
+static void move_sprites(void)
+{
+  for (int i = 0; i < SPRITES; i++) {
+    sx[i] += vx[i];
+    sy[i] += vy[i];
+    if (sx[i] < -SIZE / 2 || sx[i] > VGA_WIDTH - SIZE / 2)
+      vx[i] = -vx[i];
+    if (sy[i] < -SIZE / 2 || sy[i] > VGA_HEIGHT - SIZE / 2)
+      vy[i] = -vy[i];
+  }
+}
+
+static void sprite_frames(const char *name, int keyed, int swap)
+{
+  unsigned t = bench_cycles();
+
+  for (int f = 0; f < FRAMES; f++) {
+    vga_clear(VGA_RGB(0, 0, 64));
+    move_sprites();
+    for (int i = 0; i < SPRITES; i++) {
+      if (keyed)
+        vga_blit_key(sx[i], sy[i], SIZE, SIZE, sprite, 0);
+      else
+        vga_blit(sx[i], sy[i], SIZE, SIZE, sprite);
+    }
+    if (swap)
+      vga_swap();
+  }
+  report_fps(name, FRAMES, bench_cycles() - t);
+}
+
+int main(void)
+{
+  unsigned t;
+
+  uart_tx_init(UART_TX_UNBUFFERED);
+  vga_init();
+  print("\n==== VGA 320x240x8 ====\n");
+
+  /* A ring sprite: colour 0 (transparent for the keyed blit) outside */
+  for (int y = 0; y < SIZE; y++)
+    for (int x = 0; x < SIZE; x++) {
+      int dx = 2 * x - SIZE + 1, dy = 2 * y - SIZE + 1, r = dx * dx + dy * dy;
+      sprite[y * SIZE + x] = r < SIZE * SIZE ? VGA_RGB(8 * x, 255 - 8 * y, 128) : 0;
+    }
+  for (int i = 0; i < SPRITES; i++) {
+    sx[i] = (i * 37) % (VGA_WIDTH - SIZE);
+    sy[i] = (i * 53) % (VGA_HEIGHT - SIZE);
+    vx[i] = 1 + i % 3;
+    vy[i] = 1 + i % 2;
+  }
+
+  t = bench_cycles();
+  for (int f = 0; f < FRAMES; f++)
+    vga_clear(f);
+  report_fps("clear", FRAMES, bench_cycles() - t);
+
+  t = bench_cycles();
+  for (int f = 0; f < FRAMES; f++) {
+    vga_clear(f);
+    vga_swap();
+  }
+  report_fps("clear + swap", FRAMES, bench_cycles() - t);
+
+  sprite_frames("64 sprites", 0, 0);
+  sprite_frames("64 keyed sprites", 1, 0);
+  sprite_frames("64 keyed sprites + swap", 1, 1);
+
+  t = bench_cycles();
+  for (int f = 0; f < FRAMES; f++) {
+    vga_clear(0);
+    for (int i = 0; i < 100; i++)
+      vga_line(i * 3, 0, VGA_WIDTH - 1 - i * 3, VGA_HEIGHT - 1, VGA_RGB(255, i * 2, 0));
+  }
+  report_fps("100 lines", FRAMES, bench_cycles() - t);
+
+  vga_swap();
+  while (1);
+}
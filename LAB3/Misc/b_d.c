@@ -6,10 +6,11 @@
 
 */
 
+#include "dtekv-lib.h"
+
 // *** BUTTON CONFIGURATION ***
 #define TIME_DECREMENT 3
-#define BUTTON_DEBOUNCE_MS 10
-#define BUTTON_RELEASE_WAIT_MS 1  // Polling delay while waiting for button release
+#define DEBOUNCE_TICKS 1          // Timer ticks (0.1 s each) the button must stay released
 
 /* External function declarations - these are defined in other files */
 extern void print(const char*);
@@ -24,13 +25,14 @@ extern void enable_interrupt(void);
 /* Global variables */
 int mytime = 0x5957;                    // Current time in BCD format (59:57 = 59 min, 57 sec)
 int hours = 0;                          // Current hour (0-23)
+struct clock wall_clock;                // Binary seconds since midnight; mytime/hours mirror it
 int timeout_counter = 0;                // Counts timer interrupts (0-9, each = 0.1s)
 int prime = 1234567;                    // Used by main loop to calculate primes
+int time_step = TIME_DECREMENT;         // Seconds per button event (shell: set step)
 char textstring[] = "text, more text, and even more text!";
 
 /* Hardware I/O register pointers */
 volatile int *LED_PTR       = (volatile int *) 0x04000000; // LEDs
-volatile int *DISPLAYS_PTR  = (volatile int *) 0x04000050; // 7-segment displays
 volatile int *SWITCH_PTR    = (volatile int *) 0x04000010; // Switches (data register, offset 0)
 volatile int *BUTTON_PTR    = (volatile int *) 0x040000d0; // Buttons
 
@@ -40,94 +42,45 @@ volatile int *timer_control = (volatile int *) 0x04000024; // Offset 1
 volatile int *timer_periodl = (volatile int *) 0x04000028; // Offset 2
 volatile int *timer_periodh = (volatile int *) 0x0400002C; // Offset 3
 
-/* Button registers (Avalon PIO layout: data, direction, IRQ mask, edge capture) */
-volatile int *button_direction     = (volatile int *) (0x040000d0 + 0x04);
-volatile int *button_irq_mask      = (volatile int *) (0x040000d0 + 0x08);
-volatile int *button_edge_capture  = (volatile int *) (0x040000d0 + 0x0C);
+/* Late or missed timer interrupts, always counted (timer_health_dump) */
+struct timer_health tick_health;
+
+/* Button debouncer (Avalon PIO at BUTTON_PTR, button 0) */
+struct debouncer button;
 
 /* Helper function: Display a single digit (0-9) on a 7-segment display */
 void set_displays(int display_number, int value) {
-  // Each display is 16 bytes apart in memory (4 int-sized steps = 16 bytes)
-  volatile int *DISPLAY_PTR = DISPLAYS_PTR + 4 * display_number;
-  char pattern;
-
-  // Convert digit to 7-segment pattern
-  switch(value) {
-    case 0: pattern = 0b11000000; break;
-    case 1: pattern = 0b11111001; break;
-    case 2: pattern = 0b10100100; break;
-    case 3: pattern = 0b10110000; break;
-    case 4: pattern = 0b10011001; break;
-    case 5: pattern = 0b10010010; break;
-    case 6: pattern = 0b10000010; break;
-    case 7: pattern = 0b11111000; break;
-    case 8: pattern = 0b10000000; break;
-    case 9: pattern = 0b10010000; break;
-    default: pattern = 0xFF; break; // Off for invalid input
-  }
-  *DISPLAY_PTR = pattern; // Write pattern to the display
+  // Glyph table lookup; the register is only written if the digit changed
+  display_char(display_number, value >= 0 && value <= 9 ? '0' + value : ' ');
 }
 
 /* Helper function: Update all 7-segment displays to reflect current time */
 void update_displays(void) {
-  int sec_ones = (mytime >> 0) & 0xF;
-  int sec_tens = (mytime >> 4) & 0xF;
-  int min_ones = (mytime >> 8) & 0xF;
-  int min_tens = (mytime >> 12) & 0xF;
-  int hou_ones = hours % 10;
-  int hou_tens = hours / 10;
-
-  set_displays(0, sec_ones);
-  set_displays(1, sec_tens);
-  set_displays(2, min_ones);
-  set_displays(3, min_tens);
-  set_displays(4, hou_ones);
-  set_displays(5, hou_tens);
-}
-
-/* Helper function: Decrement time by 1 second in BCD format */
-void decrement_tick(int *time_ptr) {
-  int sec_ones = (*time_ptr >> 0) & 0xF;
-  int sec_tens = (*time_ptr >> 4) & 0xF;
-  int min_ones = (*time_ptr >> 8) & 0xF;
-  int min_tens = (*time_ptr >> 12) & 0xF;
-
-  // Decrement seconds ones digit
-  sec_ones--;
-  if (sec_ones < 0) {
-    sec_ones = 9;
-    sec_tens--;
-    if (sec_tens < 0) {
-      // Seconds underflow: reset to 59 and borrow from minutes
-      sec_ones = 9;
-      sec_tens = 5;
-      min_ones--;
-      if (min_ones < 0) {
-        min_ones = 9;
-        min_tens--;
-        if (min_tens < 0) {
-          // Minutes underflow: signal hour borrow by setting to -1
-          *time_ptr = -1;
-          return;
-        }
-      }
-    }
-  }
-
-  *time_ptr = (min_tens << 12) | (min_ones << 8) | (sec_tens << 4) | sec_ones;
+  display_bcd(clock_bcd(&wall_clock)); // 0xHHMMSS, only changed digits are written
 }
 
 /* Helper function: Decrement time by N seconds and update displays */
 void decrement_time_seconds(int seconds) {
-  for (int i = 0; i < seconds; i++) {
-    decrement_tick(&mytime);
-    if (mytime == -1) { // Underflow from 00:00
-      mytime = 0x5959; // Reset to 59:59
-      hours--;
-      if (hours < 0) hours = 23;
+  clock_add(&wall_clock, -seconds);   // One step for any amount, wraps at midnight
+  mytime = clock_bcd(&wall_clock) & 0xFFFF;
+  hours = wall_clock.seconds / 3600;
+  update_displays();
+}
+
+/* Events posted by the interrupt handlers, applied from the main loop in batches */
+#define EVENT_BATCH 8
+void handle_events(void) {
+  struct event batch[EVENT_BATCH];
+  unsigned n;
+
+  while ((n = event_drain(batch, EVENT_BATCH)) != 0) {
+    for (unsigned i = 0; i < n; i++) {
+      if (batch[i].type == EV_TICK)
+        decrement_time_seconds(batch[i].data); // One second per tick
+      else if (batch[i].type == EV_BUTTON)
+        decrement_time_seconds(time_step); // Button press
     }
   }
-  update_displays();
 }
 
 /* Initialize interrupts for timer and button */
@@ -137,11 +90,16 @@ void labinit(void) {
   *timer_periodl = period & 0xFFFF;         // Set the lower 16 bits of the period
   *timer_periodh = (period >> 16) & 0xFFFF; // Set the upper 16 bits of the period
   *timer_control = 0b111;                   // START + CONTINUOUS + INTERRUPT ENABLE (bits 0, 1, 2)
+  timer_health_init(&tick_health, period + 1, TIMER_LATE_CYCLES); // Watch it from now on
+
+  // Configure button 0 as an interrupting input, debounced by the timer
+  debounce_init(&button, BUTTON_PTR, 0x1, DEBOUNCE_TICKS, DEBOUNCE_PRESS, 0, 0);
 
-  // Configure button: set as input and enable interrupt
-  *button_direction = 0x0;                  // All buttons as input
-  *button_edge_capture = 0x1;               // Clear any stale edges
-  *button_irq_mask = 0x1;                   // Enable IRQ for button 0 (bit 0)
+  // Live tuning over the JTAG UART, e.g. "set step 5"
+  shell_init();
+  shell_var("step", &time_step);
+
+  clock_set_bcd(&wall_clock, mytime);       // Start from 00:59:57
 
   // Initialize displays to show the starting time immediately
   update_displays();
@@ -155,49 +113,33 @@ void handle_interrupt(unsigned cause) {
 
   // ====== TIMER INTERRUPT (IRQ 16) ======
   if (cause == 16 && (*timer_status & 1)) {
+    timer_health_tick(&tick_health); // Latency since the timeout, before it is acknowledged
+
     // Acknowledge timer interrupt by clearing the status bit
     *timer_status = 0;
 
+    debounce_tick(&button); // Advance the debounce state machine
+    uart_rx_isr(); // Collect typed input even if the UART IRQ is not wired
+
     timeout_counter++; // Increment the timeout counter (0-9 for deciseconds)
 
     if (timeout_counter == 10) { // Every 1 second (10 × 0.1s)
       timeout_counter = 0; // Reset the timeout counter
-      decrement_time_seconds(1);
+      event_post(EV_TICK, 1); // The main loop updates the clock
     }
     return;
   }
 
   // ====== BUTTON INTERRUPT (IRQ 18) ======
   if (cause == 18) {
-    unsigned int edges = *button_edge_capture; // Read latched edges
-
-    if (edges & 0x1) { // Check if button 0 triggered
-      // Temporarily disable button interrupts to prevent retriggering
-      *button_irq_mask = 0;
-
-      // Clear the edge capture register
-      *button_edge_capture = edges;
-
-      // Decrement time by configured amount
-      decrement_time_seconds(TIME_DECREMENT);
-
-      // Debounce: wait for hardware to settle
-      delay(BUTTON_DEBOUNCE_MS);
-
-      // Wait for button to be released to prevent multiple decrements on hold
-      while ((*BUTTON_PTR & 0x1) != 0) {
-        delay(BUTTON_RELEASE_WAIT_MS);
-      }
-
-      // Clear any residual edges from the release
-      *button_edge_capture = *button_edge_capture;
+    if (debounce_edge(&button)) // Acknowledge, mask until settled
+      event_post(EV_BUTTON, button.level); // Report the accepted edge
+    return;
+  }
 
-      // Re-enable the button interrupt
-      *button_irq_mask = 0x1;
-    } else {
-      // Clear any other edges
-      *button_edge_capture = edges;
-    }
+  // ====== JTAG UART INTERRUPT ======
+  if (cause == JTAG_UART_IRQ) {
+    uart_rx_isr(); // Move typed characters into the receive ring
     return;
   }
 }
@@ -211,5 +153,8 @@ int main(void) {
     prime = nextprime(prime);
     print_dec(prime);
     print("\n");
+
+    handle_events(); // Apply whatever the interrupt handlers posted
+    shell_poll(); // Run any command typed on the host
   }
 }
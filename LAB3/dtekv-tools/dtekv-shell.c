@@ -0,0 +1,228 @@
+/****************************************************************
+ Description: dtekv-run with a two-way console. Uploads and boots a
+              binary the same way, then delivers every line typed on
+              stdin to the firmware's shell (dtekv-shell.c in
+              Assignment_3). The loader's write command is the only
+              host-to-board path known to work while a program runs,
+              so each line is written with MM_upload into the
+              shell_mailbox variable (--mailbox, its address from nm)
+              and shell_poll picks it up. Without a binary it
+              attaches to the program that is already running.
+ ****************************************************************/
+
+#include "atlantic.h"
+#include <assert.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* struct shell_mailbox in Assignment_3/dtekv-lib.h */
+#define SHELL_LINE_SIZE 80
+#define SHELL_MAILBOX_SLOTS 4
+#define MAILBOX_HEAD (SHELL_MAILBOX_SLOTS * SHELL_LINE_SIZE)
+
+JTAGATLANTIC *atlantic;
+unsigned mailbox;
+unsigned mailbox_head;
+
+/* Same write protocol as dtekv-run.c. */
+void MM_upload(unsigned adr, char *val, unsigned int len) {
+  char *data = (char *)malloc(len + 9);
+  data[0] = 0x1; // Write command
+  data[1] = (adr & 0xff);
+  data[2] = (adr >> 8) & 0xff;
+  data[3] = (adr >> 16) & 0xff;
+  data[4] = ((adr >> 24) & 0xff);
+  data[5] = (len & 0xff);
+  data[6] = (len >> 8) & 0xff;
+  data[7] = (len >> 16) & 0xff;
+  data[8] = ((len >> 24) & 0xff);
+  for (unsigned int i = 0; i < len; i++)
+    data[9 + i] = val[i];
+
+  int to_transfer = 9 + len;
+  char *data_back = data;
+
+again:;
+  int ret = jtagatlantic_write(atlantic, data, to_transfer);
+  jtagatlantic_flush(atlantic);
+  if (ret != to_transfer) {
+    to_transfer -= ret;
+    data += ret;
+    goto again;
+  }
+
+  free(data_back);
+}
+
+/* Description: Uploads a RISC-V binary to the DTEK-V board. */
+void load_riscv_program(const char *name, char cmd) {
+  FILE *fp = fopen(name, "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "No such file: %s\n", name);
+    jtagatlantic_close(atlantic);
+    exit(0);
+  }
+  fseek(fp, 0, SEEK_END);
+  long code_size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  char *raw_code = (char *)malloc(sizeof(char) * (code_size + 1));
+  assert(raw_code != NULL);
+  if (fread(raw_code, code_size, 1, fp) != 1 && code_size != 0) {
+    fprintf(stderr, "Could not read %s\n", name);
+    exit(1);
+  }
+  fclose(fp);
+
+  fprintf(stderr, "Loaded binary '%s' with size %ld bytes.\n", name, code_size);
+
+  fprintf(stderr, "Loading binary to FPGA-device: \n");
+  MM_upload(0x00000000, raw_code, code_size);
+  fprintf(stderr, "Complete!\n");
+  MM_upload(0x04000000, &cmd, 1);
+
+  free(raw_code);
+}
+
+/* Description: Put one line (without its newline) in the next mailbox
+   slot, then publish it by moving head, in that order. */
+void send_line(char *line, unsigned len) {
+  unsigned char head[4];
+
+  if (len > SHELL_LINE_SIZE - 1) {
+    fprintf(stderr, "Line cut to %d characters.\n", SHELL_LINE_SIZE - 1);
+    len = SHELL_LINE_SIZE - 1;
+  }
+  line[len] = '\0';
+  MM_upload(mailbox + (mailbox_head % SHELL_MAILBOX_SLOTS) * SHELL_LINE_SIZE,
+            line, len + 1);
+  mailbox_head++;
+  for (int i = 0; i < 4; i++)
+    head[i] = mailbox_head >> (8 * i);
+  MM_upload(mailbox + MAILBOX_HEAD, (char *)head, 4);
+}
+
+/* Description: Send every complete line waiting on stdin to the board.
+   Returns false once stdin is closed. */
+bool forward_stdin() {
+  static char line[4096];
+  static unsigned len;
+  struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+
+  if (poll(&pfd, 1, 0) <= 0)
+    return true;
+  ssize_t n = read(STDIN_FILENO, line + len, sizeof(line) - 1 - len);
+  if (n <= 0)
+    return false;
+  len += n;
+  for (;;) {
+    char *nl = (char *)memchr(line, '\n', len);
+    if (nl == NULL)
+      break;
+    unsigned used = nl - line + 1;
+    send_line(line, nl - line - (nl > line && nl[-1] == '\r'));
+    memmove(line, line + used, len - used);
+    len -= used;
+  }
+  if (len == sizeof(line) - 1)
+    len = 0;                          // No newline in sight: drop it
+  return true;
+}
+
+void usage() {
+  fprintf(stderr, "Usage: ./dtekv-shell [test.bin] [OPTION]...\n\n"
+                  "Optional arguments:\n"
+                  "  ./dtekv-shell test.bin          "
+                  "Upload and start a binary first (e.g. test.bin)\n"
+                  "  --mailbox 0x1234                "
+                  "Address of shell_mailbox (required, see nm)\n"
+                  "  --config 0xf0                   "
+                  "Specify configuration code (e.g., 0xf0)\n"
+                  "  --cable \"USB-Blaster [3-2]\"   "
+                  "Specify cable type (e.g., \"USB-Blaster [3-2]\")\n");
+}
+
+int main(int argc, char *argv[]) {
+  bool attempt_reboot = false;
+  bool input_open = true;
+  char *binary_file_name = NULL;
+  char *cable = NULL;
+  char cmd = 0xf0;
+
+  // parse arguments
+  for (int counter = 1; counter < argc; counter++) {
+    if (strncmp(argv[counter], "--", 2) == 0) {
+      if (argc == counter + 1) {
+        fprintf(stderr, "Please provide additional arguments.\n");
+        usage();
+        return 1;
+      } else if (strcmp(argv[counter], "--config") == 0) {
+        counter++;
+        cmd = strtol(argv[counter], NULL, 16);
+      } else if (strcmp(argv[counter], "--cable") == 0) {
+        counter++;
+        cable = argv[counter];
+      } else if (strcmp(argv[counter], "--mailbox") == 0) {
+        counter++;
+        mailbox = strtoul(argv[counter], NULL, 16);
+      }
+    } else {
+      binary_file_name = argv[counter];
+    }
+  }
+
+  if (mailbox == 0) {
+    fprintf(stderr, "Please give the address of shell_mailbox.\n");
+    usage();
+    return 1;
+  }
+  // A new session starts its line count far from the last one's, so
+  // shell_poll can tell the two apart (see mailbox_poll)
+  mailbox_head = (unsigned)time(NULL) << 8;
+
+_main:;
+  /* Open the JTAG for communication */
+  atlantic = jtagatlantic_open(cable, -1, -1, "main");
+  if (!atlantic) {
+    const char *err = show_err();
+
+    if (attempt_reboot == false && err != NULL &&
+        strcmp(err, "Cable not available") == 0) {
+      fprintf(stderr, "Attempting to reboot jtagd...\n");
+      system("killall jtagd > /dev/null");
+      system("jtagd --user-start > /dev/null");
+      attempt_reboot = true;
+      goto _main;
+    } else {
+      return 1;
+    }
+  }
+  show_info(atlantic);
+  jtagatlantic_flush(atlantic);
+  fprintf(stderr, "Unplug the cable or press ^C to stop.\n");
+
+  if (binary_file_name != NULL)
+    load_riscv_program(binary_file_name, cmd);
+  fprintf(stderr, "--> Starting console; lines typed here go to the board.\n");
+  while (1) {
+    char buf[256];
+    int left = jtagatlantic_bytes_available(atlantic);
+    if (left > (int)sizeof(buf))
+      left = sizeof(buf);
+    if (left > 0) {
+      int ret = jtagatlantic_read(atlantic, buf, left);
+      if (ret > 0)
+        fwrite(buf, 1, ret, stderr);
+    }
+    if (input_open)
+      input_open = forward_stdin();
+    if (left <= 0)
+      usleep(1000);
+  }
+  jtagatlantic_close(atlantic);
+  return 0;
+}